@@ -0,0 +1,210 @@
+//
+//  AllocationBudget.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone allocation budget check, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -DSET_SPOTTER_ALLOCATION_TRACKING -Iinclude bench/AllocationBudget.cpp src/*.cpp $(pkg-config --cflags --libs opencv4) -lpthread
+//
+//  Usage: a.out <capture file> [--record] [--budgets FILE] [--max-allocations N] [--max-bytes N]
+//            [--max-scratch N] [--threads N]
+//
+//  Replays a capture and fails if any steady-state frame allocates more
+//  than the budget.  The first frames are skipped so the classification
+//  cache, highlight overlay and thread pool statistics are warm.
+//
+//  Budgets come from measuring, not guessing, and are checked in:
+//  --record replays a representative capture on the target device and
+//  writes the budgets just above its worst steady-state frame to the
+//  budget file (bench/AllocationBudget.txt by default).  Every other run
+//  enforces the budgets in that file, and fails if there are none, so
+//  running without flags checks the recorded numbers.  The --max flags
+//  override single budgets.  Lower the recorded budgets as allocations
+//  are taken out of the hot path so they can't creep back in.
+//
+
+#include "AllocationTracker.h"
+#include "FrameProcessor.h"
+#include "SessionCapture.h"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+
+const int WARMUP_FRAMES = 10;
+
+// Recorded budgets leave this much room above the worst measured frame
+const double BUDGET_HEADROOM = 1.1;
+
+// Relative to cpp/, where the tool is built and run
+const std::string DEFAULT_BUDGET_FILE = "bench/AllocationBudget.txt";
+
+// Per-frame budgets, summed over every stage.  Unset budgets aren't checked
+struct AllocationBudgets {
+   std::optional<uint64_t> maxAllocations;
+   std::optional<uint64_t> maxBytes;
+   std::optional<int64_t> maxScratchBytes;
+};
+
+/**
+ * Budget files hold one "<flag name> <value>" pair per line, for example
+ * "max-allocations 120".  A missing file leaves the budgets unset.
+ */
+static void
+readBudgets(
+   const std::string& path,
+   AllocationBudgets& budgets)
+{
+   std::ifstream file(path);
+   std::string name;
+   int64_t value;
+   while (file >> name >> value) {
+      if (name == "max-allocations") {
+         budgets.maxAllocations = value;
+      } else if (name == "max-bytes") {
+         budgets.maxBytes = value;
+      } else if (name == "max-scratch") {
+         budgets.maxScratchBytes = value;
+      } else {
+         throw std::runtime_error("Unknown budget " + name + " in " + path);
+      }
+   }
+}
+
+static void
+writeBudgets(
+   const std::string& path,
+   const AllocationBudgets& budgets)
+{
+   std::ofstream file(path);
+   file << "max-allocations " << *budgets.maxAllocations << "\n" <<
+      "max-bytes " << *budgets.maxBytes << "\n" <<
+      "max-scratch " << *budgets.maxScratchBytes << "\n";
+   if (!file) {
+      throw std::runtime_error("Unable to write budgets to " + path);
+   }
+}
+
+int
+main(int argc, char** argv)
+{
+   if (argc < 2) {
+      std::cout << "usage: " << argv[0] << " <capture file> [--record] [--budgets FILE] " <<
+         "[--max-allocations N] [--max-bytes N] [--max-scratch N] [--threads N]" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   bool record = false;
+   std::string budgetFile = DEFAULT_BUDGET_FILE;
+   AllocationBudgets flagBudgets;
+   int numThreads = tp::DEFAULT_NUM_THREADS;
+   for (int i = 2; i < argc; i++) {
+      if (std::strcmp(argv[i], "--record") == 0) {
+         record = true;
+      } else if (std::strcmp(argv[i], "--budgets") == 0 && i + 1 < argc) {
+         budgetFile = argv[++i];
+      } else if (std::strcmp(argv[i], "--max-allocations") == 0 && i + 1 < argc) {
+         flagBudgets.maxAllocations = std::strtoull(argv[++i], nullptr, 10);
+      } else if (std::strcmp(argv[i], "--max-bytes") == 0 && i + 1 < argc) {
+         flagBudgets.maxBytes = std::strtoull(argv[++i], nullptr, 10);
+      } else if (std::strcmp(argv[i], "--max-scratch") == 0 && i + 1 < argc) {
+         flagBudgets.maxScratchBytes = std::strtoll(argv[++i], nullptr, 10);
+      } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+         numThreads = std::atoi(argv[++i]);
+      } else {
+         std::cout << "unknown argument " << argv[i] << std::endl;
+         return EXIT_FAILURE;
+      }
+   }
+
+   // The recorded budgets, with any given on the command line taking precedence
+   AllocationBudgets budgets;
+   if (!record) {
+      readBudgets(budgetFile, budgets);
+      if (flagBudgets.maxAllocations) budgets.maxAllocations = flagBudgets.maxAllocations;
+      if (flagBudgets.maxBytes) budgets.maxBytes = flagBudgets.maxBytes;
+      if (flagBudgets.maxScratchBytes) budgets.maxScratchBytes = flagBudgets.maxScratchBytes;
+      if (!budgets.maxAllocations && !budgets.maxBytes && !budgets.maxScratchBytes) {
+         std::cout << "no budgets in " << budgetFile << ", record them with --record on a representative " <<
+            "capture and check the file in" << std::endl;
+         return EXIT_FAILURE;
+      }
+   }
+
+   if (!AllocationTracker::isTrackingHeap()) {
+      std::cout << "build with -DSET_SPOTTER_ALLOCATION_TRACKING to count heap allocations" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   SessionReplay replay(argv[1]);
+   if (replay.GetNumFrames() <= WARMUP_FRAMES) {
+      std::cout << "capture needs more than " << WARMUP_FRAMES << " frames" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   FrameProcessor frameProcessor(numThreads);
+   AllocationTracker::setEnabled(true);
+
+   StageAllocations stageTotals = {};
+   uint64_t worstAllocations = 0;
+   uint64_t worstBytes = 0;
+   int64_t worstScratchBytes = 0;
+   int numOverBudget = 0;
+   cv::Mat frame;
+   for (int i = 0; i < replay.GetNumFrames(); i++) {
+      replay.getFrame(i).frame.copyTo(frame);
+      frameProcessor.Process(frame);
+      if (i < WARMUP_FRAMES) continue;
+
+      uint64_t frameAllocations = 0;
+      uint64_t frameBytes = 0;
+      const StageAllocations& stageAllocations = frameProcessor.GetStageAllocations();
+      for (int stage = 0; stage < NUM_PROCESS_STAGES; stage++) {
+         stageTotals[stage].numAllocations += stageAllocations[stage].numAllocations;
+         stageTotals[stage].bytesAllocated += stageAllocations[stage].bytesAllocated;
+         frameAllocations += stageAllocations[stage].numAllocations;
+         frameBytes += stageAllocations[stage].bytesAllocated;
+      }
+      const int64_t scratchBytes = frameProcessor.GetPeakScratchBytes();
+
+      worstAllocations = std::max(worstAllocations, frameAllocations);
+      worstBytes = std::max(worstBytes, frameBytes);
+      worstScratchBytes = std::max(worstScratchBytes, scratchBytes);
+      if ((budgets.maxAllocations && frameAllocations > *budgets.maxAllocations) ||
+         (budgets.maxBytes && frameBytes > *budgets.maxBytes) ||
+         (budgets.maxScratchBytes && scratchBytes > *budgets.maxScratchBytes)) {
+         numOverBudget++;
+      }
+   }
+   AllocationTracker::setEnabled(false);
+
+   const int numMeasured = replay.GetNumFrames() - WARMUP_FRAMES;
+   std::cout << std::left << std::setw(12) << "stage" << std::setw(16) << "allocs/frame" <<
+      "bytes/frame" << std::endl;
+   for (int stage = 0; stage < NUM_PROCESS_STAGES; stage++) {
+      std::cout << std::setw(12) << PROCESS_STAGE_TO_STRING[stage] <<
+         std::setw(16) << stageTotals[stage].numAllocations / numMeasured <<
+         stageTotals[stage].bytesAllocated / numMeasured << std::endl;
+   }
+   std::cout << "worst frame: " << worstAllocations << " allocations, " << worstBytes <<
+      " bytes, " << worstScratchBytes << " bytes peak scratch" << std::endl;
+   if (record) {
+      AllocationBudgets recorded;
+      recorded.maxAllocations = (uint64_t)(worstAllocations * BUDGET_HEADROOM) + 1;
+      recorded.maxBytes = (uint64_t)(worstBytes * BUDGET_HEADROOM) + 1;
+      recorded.maxScratchBytes = (int64_t)(worstScratchBytes * BUDGET_HEADROOM) + 1;
+      writeBudgets(budgetFile, recorded);
+      std::cout << "recorded budgets in " << budgetFile << ": " << *recorded.maxAllocations <<
+         " allocations, " << *recorded.maxBytes << " bytes, " << *recorded.maxScratchBytes <<
+         " bytes peak scratch" << std::endl;
+      return EXIT_SUCCESS;
+   }
+   std::cout << numOverBudget << " of " << numMeasured << " frames over budget" << std::endl;
+
+   return numOverBudget == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
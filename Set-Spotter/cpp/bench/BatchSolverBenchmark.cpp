@@ -0,0 +1,128 @@
+//
+//  BatchSolverBenchmark.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone benchmark, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude bench/BatchSolverBenchmark.cpp src/BatchSolver.cpp src/SetGame.cpp src/ThreadPool.cpp -lpthread
+//
+
+#include "BatchSolver.h"
+#include "SetGame.h"
+
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <thread>
+
+const int NUM_BOARDS = 1000000;
+const int MIN_BOARD_SIZE = 12;
+
+static std::vector<SetGame::Board>
+makeBoards(
+   const int numBoards)
+{
+   std::mt19937 rng(42);
+   std::uniform_int_distribution<int> sizeDist(MIN_BOARD_SIZE, SetGame::MAX_BOARD_SIZE);
+   std::array<SetGame::CardCode, SetGame::NUM_CARD_CODES> deck;
+   std::iota(deck.begin(), deck.end(), 0);
+
+   std::vector<SetGame::Board> boards(numBoards);
+   for (auto& board : boards) {
+      // Partial Fisher-Yates shuffle to draw distinct cards
+      board.size = sizeDist(rng);
+      for (int i = 0; i < board.size; i++) {
+         std::uniform_int_distribution<int> pick(i, SetGame::NUM_CARD_CODES - 1);
+         std::swap(deck[i], deck[pick(rng)]);
+         board.codes[i] = deck[i];
+      }
+   }
+
+   return boards;
+}
+
+/**
+ * Baseline: the triple loop FrameProcessor used to find sets on each board,
+ * minus constructing and sorting the Set objects.
+ */
+static std::vector<int>
+countWithIsSet(
+   const std::vector<SetGame::Board>& boards)
+{
+   std::vector<int> counts;
+   counts.reserve(boards.size());
+   std::vector<SetGame::Card> cards;
+   for (const auto& board : boards) {
+      cards.clear();
+      for (int i = 0; i < board.size; i++) {
+         cards.push_back(SetGame::decodeCard(board.codes[i], i));
+      }
+
+      int count = 0;
+      for (int i = 0; i < cards.size(); i++) {
+         for (int j = i + 1; j < cards.size(); j++) {
+            for (int k = j + 1; k < cards.size(); k++) {
+               count += SetGame::Set::isSet(cards[i], cards[j], cards[k]);
+            }
+         }
+      }
+      counts.push_back(count);
+   }
+
+   return counts;
+}
+
+template <typename F>
+static double
+timeSeconds(
+   F fn)
+{
+   auto start = std::chrono::steady_clock::now();
+   fn();
+   std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+   return elapsed.count();
+}
+
+static void
+report(
+   const std::string& name,
+   const double seconds)
+{
+   std::cout << name << ": " << (long)(NUM_BOARDS / seconds) << " boards/s" << std::endl;
+}
+
+int
+main()
+{
+   std::vector<SetGame::Board> boards = makeBoards(NUM_BOARDS);
+
+   std::vector<int> expected;
+   report("Set::isSet loop", timeSeconds([&]() { expected = countWithIsSet(boards); }));
+
+   const int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+   for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+      SetGame::BatchSolver solver(numThreads);
+      const std::string suffix = " (" + std::to_string(numThreads) + " threads)";
+
+      std::vector<int> counts;
+      report("BatchSolver count" + suffix, timeSeconds([&]() { counts = solver.countSets(boards); }));
+      if (counts != expected) {
+         std::cout << "count mismatch against Set::isSet" << std::endl;
+         return EXIT_FAILURE;
+      }
+
+      std::vector<std::vector<SetGame::BoardSet>> sets;
+      report("BatchSolver enumerate" + suffix, timeSeconds([&]() { sets = solver.enumerateSets(boards); }));
+      for (int i = 0; i < sets.size(); i++) {
+         if (sets[i].size() != expected[i]) {
+            std::cout << "enumerate mismatch against Set::isSet" << std::endl;
+            return EXIT_FAILURE;
+         }
+      }
+   }
+
+   return EXIT_SUCCESS;
+}
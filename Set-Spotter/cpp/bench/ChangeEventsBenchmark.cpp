@@ -0,0 +1,151 @@
+//
+//  ChangeEventsBenchmark.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone benchmark, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude bench/ChangeEventsBenchmark.cpp src/ChangeEvents.cpp
+//
+//  Simulates a camera watching a 12 card spread: card centers jitter by a
+//  few pixels, cards are sometimes missed or misread for a frame, and
+//  every few seconds a set is taken and three new cards are dealt in its
+//  place.  A consumer rebuilds the spread from the events alone and is
+//  checked against the truth before every deal.  Reports the bytes a
+//  consumer receives as events against shipping every frame's full state.
+//
+
+#include "ChangeEvents.h"
+#include "SetGame.h"
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+
+const int NUM_FRAMES = 20000;
+const int FRAMES_PER_DEAL = 150;
+const int SPREAD_COLUMNS = 4;
+const int SPREAD_ROWS = 3;
+const float CARD_SIZE = 150;
+const float JITTER_PIXELS = 3;
+const double MISS_PROBABILITY = 0.03;
+const double MISREAD_PROBABILITY = 0.01;
+
+struct Consumer {
+   std::map<uint32_t, SetGame::CardCode> cards;
+   std::set<std::array<uint32_t, 3>> sets;
+
+   void apply(
+      const ChangeEvent& event)
+   {
+      const std::array<uint32_t, 3> ids = { event.cardIds[0], event.cardIds[1], event.cardIds[2] };
+      switch (event.type) {
+         case ChangeEventType::CARD_APPEARED:
+         case ChangeEventType::CARD_RECLASSIFIED:
+            cards[event.cardIds[0]] = event.code;
+            break;
+         case ChangeEventType::CARD_DISAPPEARED:
+            cards.erase(event.cardIds[0]);
+            break;
+         case ChangeEventType::SET_FOUND:
+            sets.insert(ids);
+            break;
+         case ChangeEventType::SET_LOST:
+            sets.erase(ids);
+            break;
+      }
+   }
+};
+
+int
+main()
+{
+   std::mt19937 rng(42);
+   std::uniform_real_distribution<float> jitter(-JITTER_PIXELS, JITTER_PIXELS);
+   std::bernoulli_distribution missed(MISS_PROBABILITY);
+   std::bernoulli_distribution misread(MISREAD_PROBABILITY);
+   std::uniform_int_distribution<int> anyCode(0, SetGame::NUM_CARD_CODES - 1);
+
+   // Deal distinct cards to the grid, drawing from a shuffled deck
+   std::vector<SetGame::CardCode> deck(SetGame::NUM_CARD_CODES);
+   for (int code = 0; code < SetGame::NUM_CARD_CODES; code++) {
+      deck[code] = code;
+   }
+   std::shuffle(deck.begin(), deck.end(), rng);
+   const int spreadSize = SPREAD_COLUMNS * SPREAD_ROWS;
+   std::vector<SetGame::CardCode> spread(deck.begin(), deck.begin() + spreadSize);
+   int nextCard = spreadSize;
+
+   ChangeEventTracker tracker;
+   Consumer consumer;
+   std::vector<CardObservation> observations;
+   std::vector<ChangeEvent> events;
+   uint64_t numEvents = 0;
+   uint64_t fullStateBytes = 0;
+   int numChecks = 0;
+   int numMismatches = 0;
+   std::chrono::duration<double, std::micro> updateTime(0);
+   for (int frame = 0; frame < NUM_FRAMES; frame++) {
+      if (frame > 0 && frame % FRAMES_PER_DEAL == 0) {
+         // The consumer's view should have settled on the spread since the last deal
+         std::multiset<SetGame::CardCode> expected(spread.begin(), spread.end());
+         std::multiset<SetGame::CardCode> received;
+         for (const auto& [id, code] : consumer.cards) {
+            received.insert(code);
+         }
+         const int expectedSets = SetGame::StandardSetEngine::countSets(spread.data(), spread.size());
+         numMismatches += received != expected || consumer.sets.size() != expectedSets;
+         numChecks++;
+
+         // Replace three cards, reshuffling the deck once it runs out
+         for (int i = 0; i < 3; i++) {
+            if (nextCard == deck.size()) {
+               std::shuffle(deck.begin(), deck.end(), rng);
+               nextCard = 0;
+            }
+            const SetGame::CardCode card = deck[nextCard++];
+            if (std::find(spread.begin(), spread.end(), card) != spread.end()) {
+               i--;
+               continue;
+            }
+            spread[(frame / FRAMES_PER_DEAL * 3 + i) % spreadSize] = card;
+         }
+      }
+
+      observations.clear();
+      for (int i = 0; i < spreadSize; i++) {
+         if (missed(rng)) continue;
+
+         const SetGame::CardCode code = misread(rng) ? anyCode(rng) : spread[i];
+         const float x = (i % SPREAD_COLUMNS + 0.5) * CARD_SIZE * 1.3 + jitter(rng);
+         const float y = (i / SPREAD_COLUMNS + 0.5) * CARD_SIZE * 1.6 + jitter(rng);
+         observations.push_back({ code, x, y, CARD_SIZE });
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      tracker.update(observations, events);
+      updateTime += std::chrono::steady_clock::now() - start;
+
+      for (const ChangeEvent& event : events) {
+         consumer.apply(event);
+      }
+      numEvents += events.size();
+
+      // A frame header, every card and every set's codes
+      const int numSets = SetGame::StandardSetEngine::countSets(spread.data(), spread.size());
+      fullStateBytes += sizeof(uint32_t) + observations.size() * sizeof(CardObservation) +
+         numSets * 3 * sizeof(SetGame::CardCode);
+   }
+
+   const uint64_t eventBytes = numEvents * sizeof(ChangeEvent);
+   std::cout << NUM_FRAMES << " frames, " << numEvents << " events" << std::endl;
+   std::cout << "full state: " << fullStateBytes << " bytes, events: " << eventBytes << " bytes (" <<
+      (double)fullStateBytes / eventBytes << "x less)" << std::endl;
+   std::cout << "update: " << updateTime.count() / NUM_FRAMES << " us/frame" << std::endl;
+   std::cout << "consumer state checks: " << numChecks - numMismatches << "/" << numChecks << " matched" << std::endl;
+
+   return numMismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,122 @@
+//
+//  IncrementalSetsBenchmark.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone benchmark, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude bench/IncrementalSetsBenchmark.cpp src/IncrementalSetSolver.cpp src/BatchSolver.cpp src/SetGame.cpp src/ThreadPool.cpp src/Trace.cpp -lpthread
+//
+//  Simulates a camera watching a spread where a card or two is swapped
+//  between frames, and checks every frame's sets against a full recompute
+//  with Set::isSet.  Cards are drawn with replacement so spreads can hold
+//  duplicate cards.
+//
+
+#include "IncrementalSetSolver.h"
+#include "SetGame.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+const int NUM_FRAMES = 2000;
+const int MAX_SWAPS_PER_FRAME = 2;
+const std::vector<int> SPREAD_SIZES = { 12, 21, 40, 81 };
+
+// What FrameProcessor did for every frame before the incremental solver
+static std::vector<SetGame::Set>
+fullRecompute(
+   const std::vector<SetGame::Card>& cards)
+{
+   std::vector<SetGame::Set> sets;
+   for (int i = 0; i < cards.size(); i++) {
+      for (int j = i + 1; j < cards.size(); j++) {
+         for (int k = j + 1; k < cards.size(); k++) {
+            if (SetGame::Set::isSet(cards[i], cards[j], cards[k])) {
+               sets.push_back(SetGame::Set({ cards[i], cards[j], cards[k] }));
+            }
+         }
+      }
+   }
+
+   SetGame::IncrementalSetSolver::sortSets(sets);
+   return sets;
+}
+
+static bool
+sameSets(
+   const std::vector<SetGame::Set>& s0,
+   const std::vector<SetGame::Set>& s1)
+{
+   if (s0.size() != s1.size()) return false;
+
+   for (int i = 0; i < s0.size(); i++) {
+      for (int j = 0; j < 3; j++) {
+         if (SetGame::encodeCard(s0[i].cards[j]) != SetGame::encodeCard(s1[i].cards[j]) ||
+             s0[i].cards[j].contourIndex != s1[i].cards[j].contourIndex) return false;
+      }
+   }
+
+   return true;
+}
+
+int
+main()
+{
+   std::mt19937 rng(42);
+   std::uniform_int_distribution<int> codeDist(0, SetGame::NUM_CARD_CODES - 1);
+   std::uniform_int_distribution<int> swapDist(0, MAX_SWAPS_PER_FRAME);
+
+   for (int spreadSize : SPREAD_SIZES) {
+      // Contour indices change every frame, like they do coming out of findContours
+      std::vector<SetGame::CardCode> spread;
+      for (int i = 0; i < spreadSize; i++) {
+         spread.push_back(codeDist(rng));
+      }
+      std::vector<std::vector<SetGame::Card>> frames;
+      for (int f = 0; f < NUM_FRAMES; f++) {
+         const int numSwaps = swapDist(rng);
+         for (int s = 0; s < numSwaps; s++) {
+            spread[rng() % spreadSize] = codeDist(rng);
+         }
+
+         std::vector<SetGame::Card> cards;
+         for (int i = 0; i < spreadSize; i++) {
+            cards.push_back(SetGame::decodeCard(spread[i], (i * 7 + f) % (spreadSize * 3)));
+         }
+         std::shuffle(cards.begin(), cards.end(), rng);
+         frames.push_back(cards);
+      }
+
+      std::vector<std::vector<SetGame::Set>> expected;
+      auto start = std::chrono::steady_clock::now();
+      for (const auto& cards : frames) {
+         expected.push_back(fullRecompute(cards));
+      }
+      std::chrono::duration<double, std::micro> fullElapsed = std::chrono::steady_clock::now() - start;
+
+      SetGame::IncrementalSetSolver solver;
+      std::vector<std::vector<SetGame::Set>> actual;
+      start = std::chrono::steady_clock::now();
+      for (const auto& cards : frames) {
+         actual.emplace_back();
+         solver.update(cards, actual.back());
+      }
+      std::chrono::duration<double, std::micro> incrementalElapsed = std::chrono::steady_clock::now() - start;
+
+      for (int f = 0; f < NUM_FRAMES; f++) {
+         if (!sameSets(expected[f], actual[f])) {
+            std::cout << "mismatch on frame " << f << " of the " << spreadSize << " card spread" << std::endl;
+            return EXIT_FAILURE;
+         }
+      }
+
+      std::cout << spreadSize << " cards: full " << fullElapsed.count() / NUM_FRAMES << " us/frame, incremental " <<
+         incrementalElapsed.count() / NUM_FRAMES << " us/frame (" << solver.GetNumFullUpdates() <<
+         " full updates)" << std::endl;
+   }
+
+   return EXIT_SUCCESS;
+}
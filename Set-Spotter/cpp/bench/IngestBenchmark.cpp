@@ -0,0 +1,155 @@
+//
+//  IngestBenchmark.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone stand-in producer for tools/IngestDaemon.cpp, not part of the
+//  app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude bench/IngestBenchmark.cpp src/*.cpp $(pkg-config --cflags --libs opencv4) -lpthread -lrt
+//
+//  Usage: a.out [<capture file>] [--frames NAME] [--results NAME] [--count N] [--fps N]
+//
+//  Start the daemon first.  Writes frames from the capture (or blank
+//  1280x720 frames) into the frame ring, either as fast as the daemon takes
+//  them or paced at --fps, dropping frames when the ring is full like a
+//  camera would.  Reads the results back and reports throughput and the
+//  capture-to-result latency.
+//
+
+#include "FrameIngest.h"
+
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+const int SYNTHETIC_ROWS = 720;
+const int SYNTHETIC_COLS = 1280;
+const std::chrono::seconds RESULT_TIMEOUT(5);
+
+static double
+percentile(
+   std::vector<double>& values,
+   const int percent)
+{
+   if (values.empty()) return 0;
+
+   std::sort(values.begin(), values.end());
+   return values[std::min<size_t>(values.size() - 1, values.size() * percent / 100)];
+}
+
+int
+main(int argc, char** argv)
+{
+   std::string capturePath;
+   std::string frameRingName = "/set-spotter-frames";
+   std::string resultRingName = "/set-spotter-results";
+   int count = 1000;
+   double fps = 0;
+   for (int i = 1; i < argc; i++) {
+      if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+         frameRingName = argv[++i];
+      } else if (std::strcmp(argv[i], "--results") == 0 && i + 1 < argc) {
+         resultRingName = argv[++i];
+      } else if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+         count = std::atoi(argv[++i]);
+      } else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+         fps = std::atof(argv[++i]);
+      } else {
+         capturePath = argv[i];
+      }
+   }
+
+   // Decode everything up front so the producer only copies pixels, like a camera DMA
+   std::vector<cv::Mat> frames;
+   if (!capturePath.empty()) {
+      SessionReplay replay(capturePath);
+      for (int i = 0; i < replay.GetNumFrames(); i++) {
+         frames.push_back(replay.getFrame(i).frame.clone());
+      }
+   }
+   if (frames.empty()) {
+      frames.push_back(cv::Mat(SYNTHETIC_ROWS, SYNTHETIC_COLS, CV_8UC3, cv::Scalar(90, 120, 60)));
+   }
+
+   ShmRing frameRing(frameRingName);
+   ShmRing resultRing(resultRingName);
+
+   std::vector<double> latencies;
+   std::vector<double> processMillis;
+   std::atomic<uint64_t> numSent(0);
+   std::atomic<bool> producerDone(false);
+   std::thread reader([&]() {
+      RingBackoff backoff;
+      auto lastResult = std::chrono::steady_clock::now();
+      while (true) {
+         uint64_t size;
+         const IngestResult* result = (const IngestResult*)resultRing.tryAcquireRead(size);
+         if (result == nullptr) {
+            const bool caughtUp = latencies.size() >= numSent.load();
+            if (producerDone.load() && (caughtUp || std::chrono::steady_clock::now() - lastResult > RESULT_TIMEOUT)) break;
+            backoff.wait();
+            continue;
+         }
+         backoff.reset();
+         lastResult = std::chrono::steady_clock::now();
+         latencies.push_back((ingestClockNanos() - result->captureNanos) / 1e6);
+         processMillis.push_back(result->processMillis);
+         resultRing.releaseRead();
+      }
+   });
+
+   int numDropped = 0;
+   const std::chrono::duration<double> interval(fps > 0 ? 1 / fps : 0);
+   auto start = std::chrono::steady_clock::now();
+   for (int i = 0; i < count; i++) {
+      if (fps > 0) {
+         std::this_thread::sleep_until(start +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval * i));
+      }
+
+      uint8_t* slot = frameRing.tryAcquireWrite();
+      if (slot == nullptr && fps > 0) {
+         numDropped++;
+         continue;
+      }
+      RingBackoff backoff;
+      while (slot == nullptr) {
+         backoff.wait();
+         slot = frameRing.tryAcquireWrite();
+      }
+
+      const cv::Mat& frame = frames[i % frames.size()];
+      const uint64_t pixelBytes = frame.total() * frame.elemSize();
+      if (sizeof(IngestFrameHeader) + pixelBytes > frameRing.GetSlotSize()) {
+         std::cout << "frame of " << pixelBytes << " bytes doesn't fit in a slot" << std::endl;
+         return EXIT_FAILURE;
+      }
+
+      IngestFrameHeader* header = (IngestFrameHeader*)slot;
+      header->frameId = i;
+      header->rows = frame.rows;
+      header->cols = frame.cols;
+      header->type = frame.type();
+      header->step = frame.cols * frame.elemSize();
+      cv::Mat slotFrame(frame.rows, frame.cols, frame.type(), slot + sizeof(IngestFrameHeader), header->step);
+      frame.copyTo(slotFrame);
+      header->captureNanos = ingestClockNanos();
+      frameRing.commitWrite(sizeof(IngestFrameHeader) + pixelBytes);
+      numSent++;
+   }
+   producerDone.store(true);
+   reader.join();
+   std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+   std::cout << "sent: " << numSent.load() << ", dropped at producer: " << numDropped <<
+      ", results: " << latencies.size() << std::endl;
+   std::cout << "throughput (fps): " << latencies.size() / elapsed.count() << std::endl;
+   std::cout << "capture to result (ms): p50 " << percentile(latencies, 50) <<
+      ", p99 " << percentile(latencies, 99) << std::endl;
+   std::cout << "process (ms): p50 " << percentile(processMillis, 50) <<
+      ", p99 " << percentile(processMillis, 99) << std::endl;
+
+   return EXIT_SUCCESS;
+}
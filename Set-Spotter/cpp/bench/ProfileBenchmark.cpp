@@ -0,0 +1,60 @@
+//
+//  ProfileBenchmark.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone profile comparison, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude bench/ProfileBenchmark.cpp src/*.cpp $(pkg-config --cflags --libs opencv4) -lpthread
+//
+//  Usage: a.out <capture file> [--deadline MS] [--threads N]
+//
+//  Replays a capture under every processing profile and reports latency
+//  and how often the results differ from the recording.  Record the capture
+//  with the ACCURATE profile so mismatches measure what each profile gives up.
+//
+
+#include "FrameProcessor.h"
+#include "SessionCapture.h"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+int
+main(int argc, char** argv)
+{
+   if (argc < 2) {
+      std::cout << "usage: " << argv[0] << " <capture file> [--deadline MS] [--threads N]" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   double deadlineMillis = 0;
+   int numThreads = tp::DEFAULT_NUM_THREADS;
+   for (int i = 2; i < argc; i++) {
+      if (std::strcmp(argv[i], "--deadline") == 0 && i + 1 < argc) {
+         deadlineMillis = std::atof(argv[++i]);
+      } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+         numThreads = std::atoi(argv[++i]);
+      }
+   }
+
+   SessionReplay replay(argv[1]);
+   std::cout << std::left << std::setw(10) << "profile" << std::setw(10) << "p50 (ms)" <<
+      std::setw(10) << "p99 (ms)" << std::setw(12) << "mismatched" << std::setw(10) << "partial" <<
+      "approximated cards" << std::endl;
+   for (int i = 0; i < PROCESSING_PROFILE_TO_STRING.size(); i++) {
+      FrameProcessor frameProcessor(numThreads, false);
+      frameProcessor.SetProfile(static_cast<ProcessingProfile>(i));
+      frameProcessor.SetDeadlineMillis(deadlineMillis);
+      ReplayReport report = replay.run(frameProcessor);
+
+      std::cout << std::setw(10) << PROCESSING_PROFILE_TO_STRING[i] <<
+         std::setw(10) << report.p50Millis << std::setw(10) << report.p99Millis <<
+         std::setw(12) << report.numMismatchedFrames << std::setw(10) << report.numPartialFrames <<
+         report.numApproximatedCards << std::endl;
+   }
+
+   return EXIT_SUCCESS;
+}
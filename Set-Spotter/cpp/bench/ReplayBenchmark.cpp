@@ -0,0 +1,83 @@
+//
+//  ReplayBenchmark.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone replay driver, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude bench/ReplayBenchmark.cpp src/*.cpp $(pkg-config --cflags --libs opencv4) -lpthread
+//
+//  Usage: a.out <capture file> [--recorded-rate] [--threads N]
+//               [--classification PER_SHAPE|PER_CARD|RECTIFIED|CARD_LOCAL] [--cache]
+//
+//  Mismatches are frames whose cards or sets differ from the recording, so
+//  replaying a capture recorded with the default ACCURATE profile under
+//  another --classification mode diffs that mode against PER_SHAPE, and
+//  replaying it with --cache measures the classification cache's hit rate
+//  and what it gets wrong.
+//
+
+#include "FrameProcessor.h"
+#include "SessionCapture.h"
+
+#include <cstring>
+#include <iostream>
+
+int
+main(int argc, char** argv)
+{
+   if (argc < 2) {
+      std::cout << "usage: " << argv[0] << " <capture file> [--recorded-rate] [--threads N] " <<
+         "[--classification MODE] [--cache]" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   bool recordedRate = false;
+   int numThreads = tp::DEFAULT_NUM_THREADS;
+   int classificationMode = -1;
+   bool useCache = false;
+   for (int i = 2; i < argc; i++) {
+      if (std::strcmp(argv[i], "--recorded-rate") == 0) {
+         recordedRate = true;
+      } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+         numThreads = std::atoi(argv[++i]);
+      } else if (std::strcmp(argv[i], "--classification") == 0 && i + 1 < argc) {
+         const std::string name = argv[++i];
+         for (int m = 0; m < CLASSIFICATION_MODE_TO_STRING.size(); m++) {
+            if (CLASSIFICATION_MODE_TO_STRING[m] == name) classificationMode = m;
+         }
+         if (classificationMode < 0) {
+            std::cout << "unknown classification mode " << name << std::endl;
+            return EXIT_FAILURE;
+         }
+      } else if (std::strcmp(argv[i], "--cache") == 0) {
+         useCache = true;
+      } else {
+         std::cout << "unknown argument " << argv[i] << std::endl;
+         return EXIT_FAILURE;
+      }
+   }
+
+   SessionReplay replay(argv[1]);
+   FrameProcessor frameProcessor(numThreads);
+   if (classificationMode >= 0) {
+      frameProcessor.SetClassificationMode(static_cast<ClassificationMode>(classificationMode));
+   }
+   frameProcessor.SetUseClassificationCache(useCache);
+   ReplayReport report = replay.run(frameProcessor, recordedRate);
+
+   std::cout << "frames:      " << report.numFrames << std::endl;
+   std::cout << "mismatched:  " << report.numMismatchedFrames << std::endl;
+   std::cout << "fps:         " << report.fps << std::endl;
+   std::cout << "p50 (ms):    " << report.p50Millis << std::endl;
+   std::cout << "p99 (ms):    " << report.p99Millis << std::endl;
+   std::cout << "jitter (ms): " << report.jitterMillis << std::endl;
+   if (useCache) {
+      const ClassificationCache& cache = frameProcessor.GetClassificationCache();
+      std::cout << "cache hits:  " << cache.GetHitRate() * 100 << "% (" << cache.GetPlacementHits() <<
+         " of " << cache.GetHits() << " by placement)" << std::endl;
+   }
+
+   return report.numMismatchedFrames == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
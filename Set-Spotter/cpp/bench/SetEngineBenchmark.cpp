@@ -0,0 +1,137 @@
+//
+//  SetEngineBenchmark.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone check and benchmark, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude bench/SetEngineBenchmark.cpp
+//
+//  Checks several deck shapes against a brute-force search over every
+//  combination of cards, then times the standard game's set counting.
+//
+
+#include "SetEngine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+const int NUM_TRIALS = 200;
+const int NUM_TIMED_BOARDS = 1000000;
+const int TIMED_BOARD_SIZE = 12;
+
+static_assert(SetGame::StandardSetEngine::thirdCard(0, 1) == 2, "0, 1 and 2 only differ in count");
+static_assert(SetGame::StandardSetEngine::decode(SetGame::StandardSetEngine::encode({ 1, 2, 0, 1 }))[1] == 2,
+   "decode should undo encode");
+
+template <typename Engine>
+static int
+bruteForceCount(
+   const typename Engine::Code* codes,
+   const int n)
+{
+   const int arity = Engine::ARITY;
+   if (n < arity) return 0;
+
+   std::array<int, Engine::ARITY> positions;
+   for (int i = 0; i < arity; i++) {
+      positions[i] = i;
+   }
+
+   int count = 0;
+   while (true) {
+      bool isSet = true;
+      for (int attribute = 0; attribute < Engine::NUM_ATTRIBUTES; attribute++) {
+         unsigned values = 0;
+         for (const int position : positions) {
+            values |= 1u << Engine::decode(codes[position])[attribute];
+         }
+         const int numDistinct = std::popcount(values);
+         if (numDistinct != 1 && numDistinct != arity) isSet = false;
+      }
+      count += isSet;
+
+      int i = arity - 1;
+      while (i >= 0 && positions[i] == n - arity + i) i--;
+      if (i < 0) break;
+      positions[i]++;
+      for (int j = i + 1; j < arity; j++) {
+         positions[j] = positions[j - 1] + 1;
+      }
+   }
+
+   return count;
+}
+
+template <typename Engine>
+static bool
+check(
+   const int boardSize)
+{
+   std::mt19937 rng(42);
+   std::vector<typename Engine::Code> deck(Engine::NUM_CODES);
+   for (int i = 0; i < Engine::NUM_CODES; i++) {
+      deck[i] = i;
+   }
+   const int n = std::min(boardSize, Engine::NUM_CODES);
+
+   int numMismatches = 0;
+   for (int trial = 0; trial < NUM_TRIALS; trial++) {
+      std::shuffle(deck.begin(), deck.end(), rng);
+
+      int numEnumerated = 0;
+      Engine::forEachSet(deck.data(), n, [&](const std::array<int, Engine::ARITY>& positions) {
+         std::array<typename Engine::Code, Engine::ARITY> codes;
+         for (int i = 0; i < Engine::ARITY; i++) {
+            codes[i] = deck[positions[i]];
+         }
+         numEnumerated += Engine::isSet(codes);
+      });
+
+      const int expected = bruteForceCount<Engine>(deck.data(), n);
+      numMismatches += Engine::countSets(deck.data(), n) != expected || numEnumerated != expected;
+   }
+
+   std::cout << Engine::NUM_ATTRIBUTES << " attributes x " << Engine::ARITY << " values: " <<
+      (numMismatches == 0 ? "ok" : std::to_string(numMismatches) + " mismatches") << std::endl;
+   return numMismatches == 0;
+}
+
+int
+main()
+{
+   bool ok = true;
+   ok &= check<SetGame::SetEngine<3, 3>>(12);
+   ok &= check<SetGame::SetEngine<4, 3>>(21);
+   ok &= check<SetGame::SetEngine<5, 3>>(20);
+   ok &= check<SetGame::SetEngine<6, 3>>(20);
+   ok &= check<SetGame::SetEngine<4, 4>>(16);
+   ok &= check<SetGame::SetEngine<3, 5>>(14);
+
+   typedef SetGame::StandardSetEngine Engine;
+   std::mt19937 rng(7);
+   std::vector<Engine::Code> deck(Engine::NUM_CODES);
+   for (int i = 0; i < Engine::NUM_CODES; i++) {
+      deck[i] = i;
+   }
+   std::vector<Engine::Code> boards;
+   for (int i = 0; i < NUM_TIMED_BOARDS; i++) {
+      std::shuffle(deck.begin(), deck.begin() + TIMED_BOARD_SIZE * 2, rng);
+      boards.insert(boards.end(), deck.begin(), deck.begin() + TIMED_BOARD_SIZE);
+   }
+
+   auto start = std::chrono::steady_clock::now();
+   long numSets = 0;
+   for (int i = 0; i < NUM_TIMED_BOARDS; i++) {
+      numSets += Engine::countSets(boards.data() + i * TIMED_BOARD_SIZE, TIMED_BOARD_SIZE);
+   }
+   std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+   std::cout << "standard countSets: " << NUM_TIMED_BOARDS / elapsed.count() << " boards/s (" <<
+      numSets << " sets)" << std::endl;
+
+   return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,93 @@
+//
+//  ShapeSamplingBenchmark.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone shape sampling comparison, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude bench/ShapeSamplingBenchmark.cpp src/*.cpp $(pkg-config --cflags --libs opencv4) -lpthread
+//
+//  Usage: a.out <capture file> [--threads N]
+//
+//  Replays a capture with MASKED and SPARSE shape sampling under every
+//  processing profile and reports how long classification took and how
+//  many of the recorded cards each reproduced.  Record the capture with the
+//  ACCURATE profile and MASKED sampling so the recording is the reference.
+//
+
+#include "FrameProcessor.h"
+#include "SessionCapture.h"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+int
+main(int argc, char** argv)
+{
+   if (argc < 2) {
+      std::cout << "usage: " << argv[0] << " <capture file> [--threads N]" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   int numThreads = tp::DEFAULT_NUM_THREADS;
+   for (int i = 2; i < argc; i++) {
+      if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+         numThreads = std::atoi(argv[++i]);
+      }
+   }
+
+   SessionReplay replay(argv[1]);
+   if (replay.GetNumFrames() == 0) {
+      std::cout << "capture has no frames" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   std::cout << std::left << std::setw(10) << "profile" << std::setw(10) << "sampling" <<
+      std::setw(16) << "classify (ms)" << std::setw(12) << "p99 (ms)" << "cards matched" << std::endl;
+   for (int p = 0; p < PROCESSING_PROFILE_TO_STRING.size(); p++) {
+      for (int m = 0; m < SHAPE_SAMPLING_MODE_TO_STRING.size(); m++) {
+         FrameProcessor frameProcessor(numThreads, false);
+         frameProcessor.SetProfile(static_cast<ProcessingProfile>(p));
+         frameProcessor.SetShapeSamplingMode(static_cast<ShapeSamplingMode>(m));
+
+         // Cached cards would skip sampling entirely
+         frameProcessor.SetUseClassificationCache(false);
+
+         std::vector<double> classifyMillis;
+         int numRecordedCards = 0;
+         int numMatchedCards = 0;
+         cv::Mat frame;
+         for (int i = 0; i < replay.GetNumFrames(); i++) {
+            RecordedFrame recordedFrame = replay.getFrame(i);
+            recordedFrame.frame.copyTo(frame);
+            frameProcessor.Process(frame);
+            classifyMillis.push_back(frameProcessor.GetStageMillis()[static_cast<int>(ProcessStage::CLASSIFY)]);
+
+            // Both lists are sorted, count the codes they have in common
+            std::vector<SetGame::CardCode> cards = SessionReplay::encodeCards(frameProcessor.GetCardsInFrame());
+            std::vector<SetGame::CardCode> matched;
+            std::set_intersection(cards.begin(), cards.end(), recordedFrame.cards.begin(), recordedFrame.cards.end(),
+               std::back_inserter(matched));
+            numRecordedCards += recordedFrame.cards.size();
+            numMatchedCards += matched.size();
+         }
+
+         double totalMillis = 0;
+         for (const double millis : classifyMillis) {
+            totalMillis += millis;
+         }
+         std::sort(classifyMillis.begin(), classifyMillis.end());
+         const double p99Millis = classifyMillis[std::min<size_t>(classifyMillis.size() - 1,
+            classifyMillis.size() * 99 / 100)];
+
+         std::cout << std::setw(10) << PROCESSING_PROFILE_TO_STRING[p] <<
+            std::setw(10) << SHAPE_SAMPLING_MODE_TO_STRING[m] <<
+            std::setw(16) << totalMillis / classifyMillis.size() << std::setw(12) << p99Millis <<
+            numMatchedCards << "/" << numRecordedCards << std::endl;
+      }
+   }
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,374 @@
+//
+//  ThreadPoolBenchmark.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone benchmark, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude bench/ThreadPoolBenchmark.cpp src/ThreadPool.cpp -lpthread
+//
+//  Usage: a.out [--threads N,N,...] [--quick]
+//
+//  Measures the pool against a serial loop, std::thread fork/join and
+//  std::async, for each thread count:
+//
+//    round trip       one empty task handed off and waited for
+//    overhead         parallelize of trivial elements, by element count
+//    uneven           throughput when a few elements cost far more than the rest
+//    oversubscribed   a fixed workload on more threads than cores
+//    stress           many threads calling parallelize at once, checking every
+//                     element is visited exactly once
+//
+//  Times are medians over repeated runs.  The std::thread and std::async
+//  baselines split work into the same contiguous partitions as parallelize.
+//
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace tp = ThreadPool;
+
+const int ROUND_TRIP_ITERATIONS = 2000;
+const int OVERHEAD_REPETITIONS = 200;
+const int UNEVEN_REPETITIONS = 20;
+const std::vector<int> OVERHEAD_ELEMENT_COUNTS = { 1, 4, 16, 64, 256, 1024, 4096, 16384, 65536 };
+
+// Uneven workload: most elements are cheap, a few cost a lot more, clustered at the front
+const int UNEVEN_NUM_ELEMENTS = 4096;
+const int UNEVEN_CHEAP_SPINS = 200;
+const int UNEVEN_EXPENSIVE_SPINS = 20000;
+const float UNEVEN_EXPENSIVE_FRACTION = 0.05;
+
+const int OVERSUBSCRIBED_SPINS_PER_CORE = 2000000;
+const std::vector<int> OVERSUBSCRIPTION_FACTORS = { 1, 2, 4, 8 };
+
+const int STRESS_CLIENTS_PER_THREAD = 2;
+const int STRESS_CALLS_PER_CLIENT = 500;
+const int STRESS_MAX_ELEMENTS = 512;
+
+typedef std::vector<int> Elements; // Spins per element
+
+struct SpinArg : public tp::PoolTaskArg<Elements> {};
+
+static void
+spinRange(
+   Elements::iterator start,
+   Elements::iterator end)
+{
+   for (auto it = start; it != end; it++) {
+      volatile int sink = 0;
+      for (int i = 0; i < *it; i++) {
+         sink = sink + i;
+      }
+   }
+}
+
+static void
+spin(
+   void* voidArg)
+{
+   SpinArg* arg = (SpinArg*)voidArg;
+   spinRange(arg->start, arg->end);
+}
+
+struct CountArg : public tp::PoolTaskArg<Elements> {};
+
+static void
+count(
+   void* voidArg)
+{
+   CountArg* arg = (CountArg*)voidArg;
+   for (auto it = arg->start; it != arg->end; it++) {
+      (*it)++;
+   }
+}
+
+static void
+emptyTask(
+   void*)
+{
+}
+
+// The [start, end) of partition p, split the same way parallelize splits
+static std::pair<int, int>
+partitionRange(
+   const int numElements,
+   const int numPartitions,
+   const int p)
+{
+   const int partitionSize = numElements <= numPartitions ? 1 : numElements / numPartitions;
+   const int numBigPartitions = tp::ThreadPool::partition(numElements, numPartitions);
+   if (p < numBigPartitions) {
+      return { p * (partitionSize + 1), (p + 1) * (partitionSize + 1) };
+   }
+
+   return { p * partitionSize + numBigPartitions, (p + 1) * partitionSize + numBigPartitions };
+}
+
+static double
+medianMicros(
+   const int repetitions,
+   const std::function<void()>& fn)
+{
+   std::vector<double> micros;
+   for (int i = 0; i < repetitions; i++) {
+      auto start = std::chrono::steady_clock::now();
+      fn();
+      std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+      micros.push_back(elapsed.count());
+   }
+   std::nth_element(micros.begin(), micros.begin() + micros.size() / 2, micros.end());
+
+   return micros[micros.size() / 2];
+}
+
+/**
+ * The workload run each way.  Every strategy spreads the elements over
+ * numThreads contiguous partitions except serial, which runs them in order
+ * on the calling thread.
+ */
+static void
+runSerial(
+   Elements& elements)
+{
+   spinRange(elements.begin(), elements.end());
+}
+
+static void
+runPool(
+   tp::ThreadPool& pool,
+   Elements& elements)
+{
+   pool.parallelize<Elements>(spin, elements,
+      []() -> SpinArg* { return new SpinArg; });
+}
+
+static void
+runThreads(
+   const int numThreads,
+   Elements& elements)
+{
+   const int numPartitions = std::min<int>(numThreads, elements.size());
+   std::vector<std::thread> threads;
+   for (int p = 0; p < numPartitions; p++) {
+      const std::pair<int, int> range = partitionRange(elements.size(), numPartitions, p);
+      threads.emplace_back(spinRange, elements.begin() + range.first, elements.begin() + range.second);
+   }
+   for (auto& thread : threads) {
+      thread.join();
+   }
+}
+
+static void
+runAsync(
+   const int numThreads,
+   Elements& elements)
+{
+   const int numPartitions = std::min<int>(numThreads, elements.size());
+   std::vector<std::future<void>> futures;
+   for (int p = 0; p < numPartitions; p++) {
+      const std::pair<int, int> range = partitionRange(elements.size(), numPartitions, p);
+      futures.push_back(std::async(std::launch::async, spinRange,
+         elements.begin() + range.first, elements.begin() + range.second));
+   }
+   for (auto& future : futures) {
+      future.get();
+   }
+}
+
+static void
+printRow(
+   const std::string& label,
+   const std::vector<double>& values)
+{
+   std::cout << "  " << std::left << std::setw(14) << label << std::right << std::fixed << std::setprecision(2);
+   for (const double value : values) {
+      std::cout << std::setw(12) << value;
+   }
+   std::cout << std::endl;
+}
+
+static void
+printHeader(
+   const std::string& title,
+   const std::string& unit)
+{
+   std::cout << "  " << std::left << std::setw(14) << title << std::right;
+   for (const std::string column : { "serial", "pool", "std::thread", "std::async" }) {
+      std::cout << std::setw(12) << column;
+   }
+   std::cout << "  (" << unit << ")" << std::endl;
+}
+
+static void
+benchmarkRoundTrip(
+   tp::ThreadPool& pool,
+   const int iterations)
+{
+   const double serialMicros = medianMicros(iterations, []() { emptyTask(nullptr); });
+   const double poolMicros = medianMicros(iterations, [&]() {
+      tp::PoolTask task;
+      task.func = emptyTask;
+      task.arg = nullptr;
+      pool.enqueue(&task);
+      pool.waitForTask(&task);
+   });
+   const double threadMicros = medianMicros(iterations, []() { std::thread(emptyTask, nullptr).join(); });
+   const double asyncMicros = medianMicros(iterations, []() {
+      std::async(std::launch::async, emptyTask, nullptr).get();
+   });
+
+   printHeader("round trip", "us per task");
+   printRow("empty task", { serialMicros, poolMicros, threadMicros, asyncMicros });
+}
+
+static void
+benchmarkOverhead(
+   tp::ThreadPool& pool,
+   const int repetitions)
+{
+   printHeader("overhead", "us per call, 1 spin per element");
+   for (const int numElements : OVERHEAD_ELEMENT_COUNTS) {
+      Elements elements(numElements, 1);
+      printRow(std::to_string(numElements) + " elements", {
+         medianMicros(repetitions, [&]() { runSerial(elements); }),
+         medianMicros(repetitions, [&]() { runPool(pool, elements); }),
+         medianMicros(repetitions, [&]() { runThreads(pool.GetNumThreads(), elements); }),
+         medianMicros(repetitions, [&]() { runAsync(pool.GetNumThreads(), elements); })
+      });
+   }
+}
+
+static void
+benchmarkUneven(
+   tp::ThreadPool& pool,
+   const int repetitions)
+{
+   Elements elements(UNEVEN_NUM_ELEMENTS, UNEVEN_CHEAP_SPINS);
+   const int numExpensive = UNEVEN_NUM_ELEMENTS * UNEVEN_EXPENSIVE_FRACTION;
+   std::fill(elements.begin(), elements.begin() + numExpensive, UNEVEN_EXPENSIVE_SPINS);
+
+   Elements shuffled = elements;
+   std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(1));
+
+   printHeader("uneven", "thousand elements per second");
+   for (auto* workload : { &elements, &shuffled }) {
+      const auto throughput = [&](const std::function<void()>& fn) {
+         return UNEVEN_NUM_ELEMENTS / medianMicros(repetitions, fn) * 1000;
+      };
+      printRow(workload == &elements ? "clustered" : "shuffled", {
+         throughput([&]() { runSerial(*workload); }),
+         throughput([&]() { runPool(pool, *workload); }),
+         throughput([&]() { runThreads(pool.GetNumThreads(), *workload); }),
+         throughput([&]() { runAsync(pool.GetNumThreads(), *workload); })
+      });
+   }
+}
+
+static void
+benchmarkOversubscribed(
+   const int repetitions)
+{
+   const int numCores = std::max(1u, std::thread::hardware_concurrency());
+   printHeader("oversubscribed", "ms per run, " + std::to_string(numCores) + " cores");
+   for (const int factor : OVERSUBSCRIPTION_FACTORS) {
+      const int numThreads = numCores * factor;
+      tp::ThreadPool pool(numThreads);
+
+      // The same total work at every factor, one element per thread
+      Elements elements(numThreads, OVERSUBSCRIBED_SPINS_PER_CORE * numCores / numThreads);
+      printRow(std::to_string(numThreads) + " threads", {
+         medianMicros(repetitions, [&]() { runSerial(elements); }) / 1000,
+         medianMicros(repetitions, [&]() { runPool(pool, elements); }) / 1000,
+         medianMicros(repetitions, [&]() { runThreads(numThreads, elements); }) / 1000,
+         medianMicros(repetitions, [&]() { runAsync(numThreads, elements); }) / 1000
+      });
+   }
+}
+
+/**
+ * Several client threads share the pool, as frame processors sharing a
+ * pool would.  Returns false if any element was skipped or visited twice.
+ */
+static bool
+stress(
+   tp::ThreadPool& pool,
+   const int callsPerClient)
+{
+   const int numClients = pool.GetNumThreads() * STRESS_CLIENTS_PER_THREAD;
+   std::atomic<int> numFailures(0);
+   auto start = std::chrono::steady_clock::now();
+   std::vector<std::thread> clients;
+   for (int c = 0; c < numClients; c++) {
+      clients.emplace_back([&, c]() {
+         std::mt19937 random(c);
+         std::uniform_int_distribution<int> sizes(1, STRESS_MAX_ELEMENTS);
+         for (int i = 0; i < callsPerClient; i++) {
+            Elements elements(sizes(random), 0);
+            pool.parallelize<Elements>(count, elements,
+               []() -> CountArg* { return new CountArg; });
+            if (std::any_of(elements.begin(), elements.end(), [](int visits) { return visits != 1; })) {
+               numFailures++;
+            }
+         }
+      });
+   }
+   for (auto& client : clients) {
+      client.join();
+   }
+   std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+   std::cout << "  stress        " << numClients << " clients, " <<
+      (int)(numClients * callsPerClient / elapsed.count()) << " parallelize calls per second, " <<
+      numFailures.load() << " failed" << std::endl;
+
+   return numFailures.load() == 0;
+}
+
+int
+main(int argc, char** argv)
+{
+   const int numCores = std::max(1u, std::thread::hardware_concurrency());
+   std::vector<int> threadCounts = { 1, 2, 4, numCores };
+   int scale = 1;
+   for (int i = 1; i < argc; i++) {
+      if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+         threadCounts.clear();
+         std::stringstream counts(argv[++i]);
+         std::string count;
+         while (std::getline(counts, count, ',')) {
+            threadCounts.push_back(std::atoi(count.c_str()));
+         }
+      } else if (std::strcmp(argv[i], "--quick") == 0) {
+         scale = 10;
+      }
+   }
+   std::sort(threadCounts.begin(), threadCounts.end());
+   threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+   bool passed = true;
+   for (const int numThreads : threadCounts) {
+      std::cout << numThreads << " threads" << std::endl;
+      tp::ThreadPool pool(numThreads);
+      benchmarkRoundTrip(pool, ROUND_TRIP_ITERATIONS / scale);
+      benchmarkOverhead(pool, OVERHEAD_REPETITIONS / scale);
+      benchmarkUneven(pool, std::max(1, UNEVEN_REPETITIONS / scale));
+      passed &= stress(pool, STRESS_CALLS_PER_CLIENT / scale);
+      std::cout << std::endl;
+   }
+   benchmarkOversubscribed(std::max(1, UNEVEN_REPETITIONS / scale));
+
+   return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
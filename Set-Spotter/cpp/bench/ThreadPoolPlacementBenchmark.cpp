@@ -0,0 +1,95 @@
+//
+//  ThreadPoolPlacementBenchmark.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone benchmark, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude bench/ThreadPoolPlacementBenchmark.cpp src/ThreadPool.cpp -lpthread
+//
+//  Runs the same fixed workload through pools with different worker
+//  placement and reports the spread of iteration latencies.
+//
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+const int NUM_ITERATIONS = 500;
+const int SPINS_PER_ELEMENT = 200000;
+
+namespace tp = ThreadPool;
+
+struct SpinArg : public tp::PoolTaskArg<std::vector<int>> {};
+
+static void
+spin(
+   void* voidArg)
+{
+   SpinArg* arg = (SpinArg*)voidArg;
+   for (auto it = arg->start; it != arg->end; it++) {
+      volatile int sink = 0;
+      for (int i = 0; i < SPINS_PER_ELEMENT; i++) {
+         sink = sink + i;
+      }
+      *it = sink;
+   }
+}
+
+static void
+run(
+   const std::string& name,
+   const tp::ThreadPoolOptions& options)
+{
+   tp::ThreadPool pool(options);
+   std::vector<int> elements(pool.GetNumThreads() * 4);
+   std::vector<double> latencies;
+   for (int i = 0; i < NUM_ITERATIONS; i++) {
+      auto start = std::chrono::steady_clock::now();
+      pool.parallelize<std::vector<int>>(spin, elements,
+         []() -> SpinArg* { return new SpinArg; });
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      latencies.push_back(elapsed.count());
+   }
+
+   const double mean = std::accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
+   double variance = 0;
+   for (double latency : latencies) {
+      variance += (latency - mean) * (latency - mean);
+   }
+   variance /= latencies.size();
+   std::sort(latencies.begin(), latencies.end());
+
+   std::cout << name << " (" << pool.GetNumThreads() << " threads): mean " << mean <<
+      " ms, stddev " << std::sqrt(variance) << " ms, p99 " <<
+      latencies[latencies.size() * 99 / 100] << " ms" << std::endl;
+}
+
+int
+main()
+{
+   std::cout << "performance cores: " << tp::ThreadPool::numPerformanceCores() << std::endl;
+   for (const tp::CoreInfo& core : tp::ThreadPool::detectCores()) {
+      std::cout << "  cpu" << core.cpu << " capacity " << core.capacity <<
+         (core.performance ? " (performance)" : "") << std::endl;
+   }
+
+   tp::ThreadPoolOptions unpinned;
+   run("unpinned", unpinned);
+
+   tp::ThreadPoolOptions performanceCores;
+   performanceCores.performanceCoresOnly = true;
+   run("performance cores", performanceCores);
+
+   tp::ThreadPoolOptions pinnedWorkers;
+   pinnedWorkers.performanceCoresOnly = true;
+   pinnedWorkers.pinEachWorker = true;
+   run("one performance core per worker", pinnedWorkers);
+
+   return EXIT_SUCCESS;
+}
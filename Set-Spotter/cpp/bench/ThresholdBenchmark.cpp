@@ -0,0 +1,73 @@
+//
+//  ThresholdBenchmark.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone benchmark, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude bench/ThresholdBenchmark.cpp src/*.cpp $(pkg-config --cflags --libs opencv4) -lpthread
+//
+//  Usage: a.out [image]  (defaults to a synthetic 12MP frame)
+//
+//  Compares banded thresholding across 1-16 threads with the single-pass
+//  result, which it must match bit for bit.
+//
+
+#include "FrameProcessor.h"
+
+#include <chrono>
+#include <iostream>
+
+const int NUM_ITERATIONS = 10;
+
+static cv::Mat
+makeFrame()
+{
+   cv::Mat frame(3000, 4000, CV_8UC3);
+   cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+   cv::GaussianBlur(frame, frame, cv::Size(15, 15), 0);
+   for (int i = 0; i < 40; i++) {
+      cv::Rect card(100 + (i % 8) * 470, 100 + (i / 8) * 560, 400, 500);
+      cv::rectangle(frame, card, cv::Scalar(245, 245, 245), cv::FILLED);
+      cv::ellipse(frame, cv::Point(card.x + 200, card.y + 250), cv::Size(120, 60), 0, 0, 360,
+         cv::Scalar(60, 40, 200), 8);
+   }
+
+   return frame;
+}
+
+int
+main(int argc, char** argv)
+{
+   cv::Mat frame = argc > 1 ? cv::imread(argv[1]) : makeFrame();
+
+   cv::Mat grayScaleFrame, expected;
+   auto start = std::chrono::steady_clock::now();
+   for (int i = 0; i < NUM_ITERATIONS; i++) {
+      cv::cvtColor(frame, grayScaleFrame, cv::COLOR_BGR2GRAY);
+      cv::adaptiveThreshold(grayScaleFrame, expected, 255, cv::ADAPTIVE_THRESH_MEAN_C,
+         cv::THRESH_BINARY, 93, 11);
+   }
+   std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+   const double singlePassMillis = elapsed.count() / NUM_ITERATIONS;
+   std::cout << frame.cols << "x" << frame.rows << " single pass: " << singlePassMillis << " ms" << std::endl;
+
+   for (int numThreads = 1; numThreads <= 16; numThreads *= 2) {
+      FrameProcessor frameProcessor(numThreads);
+      cv::Mat threshold;
+      start = std::chrono::steady_clock::now();
+      for (int i = 0; i < NUM_ITERATIONS; i++) {
+         frameProcessor.Threshold(frame, threshold);
+      }
+      elapsed = std::chrono::steady_clock::now() - start;
+      const double millis = elapsed.count() / NUM_ITERATIONS;
+
+      const bool identical = cv::countNonZero(threshold != expected) == 0;
+      std::cout << numThreads << " threads: " << millis << " ms (" <<
+         singlePassMillis / millis << "x)" << (identical ? "" : " MISMATCH") << std::endl;
+      if (!identical) return EXIT_FAILURE;
+   }
+
+   return EXIT_SUCCESS;
+}
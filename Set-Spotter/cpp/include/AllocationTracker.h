@@ -0,0 +1,67 @@
+//
+//  AllocationTracker.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Opt-in allocation counting.
+ *
+ * Two allocators are counted: the global operator new/delete, and OpenCV's
+ * Mat allocator, which doesn't go through operator new.  Both keep running
+ * totals of allocations and bytes, plus the bytes currently live and the
+ * peak live bytes since the peak was last reset.
+ *
+ * The operator new replacement is compiled in only when
+ * SET_SPOTTER_ALLOCATION_TRACKING is defined, since it adds a header to
+ * every heap block and a few atomic operations to every allocation.
+ * Without it only Mat allocations are counted.  Mat allocations are counted
+ * once setEnabled(true) has installed the counting Mat allocator.
+ */
+namespace AllocationTracker {
+
+struct AllocationStats {
+   uint64_t numAllocations = 0;
+   uint64_t bytesAllocated = 0;
+};
+
+struct Snapshot {
+   AllocationStats totals;
+   int64_t liveBytes = 0;
+};
+
+extern std::atomic<bool> enabled;
+
+inline bool
+isEnabled()
+{
+   return enabled.load(std::memory_order_relaxed);
+}
+
+// Enabling installs the counting Mat allocator, disabling restores the previous one
+void setEnabled(bool enable);
+
+// True if the operator new replacement was compiled in
+bool isTrackingHeap();
+
+Snapshot snapshot();
+
+int64_t GetPeakLiveBytes();
+
+// Start tracking a new peak from the current live bytes
+void resetPeak();
+
+// Called by the allocation hooks
+void recordAllocation(
+   const uint64_t bytes);
+
+void recordDeallocation(
+   const uint64_t bytes);
+
+} // namespace AllocationTracker
@@ -0,0 +1,117 @@
+//
+//  BatchFrameProcessor.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include "FrameProcessor.h"
+#include "SetGame.h"
+#include "ThreadPool.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Flat, fixed-size result records for offline evaluation.  A batch's
+ * results are three arrays of these--one record per frame, per card and
+ * per set--so they can be handed to other languages as structured arrays
+ * without building an object per card.
+ */
+struct BatchFrameRecord {
+   uint32_t frameIndex;
+   uint32_t numCards;
+   uint32_t numSets;
+   uint8_t partial;
+   uint8_t reserved[3];
+   float processMillis;
+};
+
+struct BatchCardRecord {
+   uint32_t frameIndex;
+   int32_t contourIndex;
+   SetGame::CardCode code;
+   uint8_t count;
+   uint8_t color;
+   uint8_t symbol;
+   uint8_t shading;
+   uint8_t reserved[3];
+};
+
+struct BatchSetRecord {
+   uint32_t frameIndex;
+   int32_t contourIndices[3];
+   SetGame::CardCode codes[3];
+   uint8_t reserved;
+};
+
+struct BatchResults {
+   std::vector<BatchFrameRecord> frames;
+   std::vector<BatchCardRecord> cards; // Ordered by frame
+   std::vector<BatchSetRecord> sets; // Ordered by frame
+};
+
+class BatchFrameArg : public tp::PoolTaskArg<std::vector<int>> {
+public:
+   BatchFrameArg(
+      std::vector<cv::Mat>& _frames,
+      std::vector<FrameProcessor*>& _idleProcessors,
+      pthread_mutex_t* _processorsMutex,
+      std::vector<BatchResults>& _frameResults) :
+         frames(_frames),
+         idleProcessors(_idleProcessors),
+         processorsMutex(_processorsMutex),
+         frameResults(_frameResults) {}
+
+   BatchFrameArg() = delete;
+
+   std::vector<cv::Mat>& frames; // Each task processes only its own frames in place
+   std::vector<FrameProcessor*>& idleProcessors; // Guarded by processorsMutex
+   pthread_mutex_t* processorsMutex;
+   std::vector<BatchResults>& frameResults; // Write, each task writes only its own frames
+};
+
+/**
+ * Processes batches of independent frames, such as a recorded session,
+ * across a thread pool.  Each worker runs whole frames with its own
+ * single-threaded FrameProcessor, which scales better than splitting every
+ * frame's stages across the pool when there are many frames to get through.
+ * Frames are independent: each one's results are the same as processing
+ * it alone with a new FrameProcessor, whichever worker gets it.
+ */
+class BatchFrameProcessor {
+public:
+   BatchFrameProcessor(
+      int numThreads = tp::AUTO_NUM_THREADS,
+      const ProcessingProfile profile = ProcessingProfile::ACCURATE);
+   ~BatchFrameProcessor();
+
+   BatchFrameProcessor(const BatchFrameProcessor&) = delete;
+   BatchFrameProcessor& operator=(const BatchFrameProcessor&) = delete;
+
+   int GetNumThreads() const { return _threadPool.GetNumThreads(); }
+
+   // Frames must be 8-bit BGR.  They're processed in place but not drawn on.
+   BatchResults processBatch(
+      std::vector<cv::Mat>& frames);
+
+   static void appendResults(
+      const FrameProcessor& frameProcessor,
+      const uint32_t frameIndex,
+      const double processMillis,
+      BatchResults& results);
+
+private:
+   static void processFrames(
+      void* arg);
+
+private:
+   tp::ThreadPool _threadPool;
+   std::vector<std::unique_ptr<FrameProcessor>> _frameProcessors;
+   pthread_mutex_t _processorsMutex;
+};
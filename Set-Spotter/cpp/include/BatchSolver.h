@@ -0,0 +1,90 @@
+//
+//  BatchSolver.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include "SetGame.h"
+#include "ThreadPool.h"
+
+#include <array>
+#include <vector>
+
+namespace SetGame {
+
+const int MAX_BOARD_SIZE = 21;
+
+/**
+ * A board of distinct cards stored as packed card codes.
+ */
+struct Board {
+   std::array<CardCode, MAX_BOARD_SIZE> codes;
+   int size = 0;
+};
+
+/**
+ * A set found on a board, stored as the positions of its three cards in
+ * the board's "codes" array (ascending).
+ */
+struct BoardSet {
+   std::array<uint8_t, 3> indices;
+};
+
+class SolveBoardsArg : public ThreadPool::PoolTaskArg<std::vector<Board>> {
+public:
+   SolveBoardsArg(
+      const std::vector<Board>::iterator _first,
+      std::vector<int>* _counts,
+      std::vector<std::vector<BoardSet>>* _sets) :
+         first(_first),
+         counts(_counts),
+         sets(_sets) {}
+
+   SolveBoardsArg() = delete;
+
+   const std::vector<Board>::iterator first; // Read-only
+   std::vector<int>* counts; // Write, null when enumerating
+   std::vector<std::vector<BoardSet>>* sets; // Write, null when counting
+};
+
+/**
+ * Solves large numbers of boards at once, e.g. for replaying game logs.
+ * Boards are sharded across a thread pool and each board is evaluated with
+ * StandardSetEngine's presence bitset and third-card table, so finding
+ * every set on an n card board costs n * (n - 1) / 2 table lookups and no
+ * attribute comparisons.
+ */
+class BatchSolver {
+public:
+   BatchSolver(int numThreads = ThreadPool::DEFAULT_NUM_THREADS) :
+      _threadPool(numThreads) {}
+
+   std::vector<int> countSets(
+      std::vector<Board>& boards);
+
+   std::vector<std::vector<BoardSet>> enumerateSets(
+      std::vector<Board>& boards);
+
+   static int countSets(
+      const Board& board);
+
+   static void enumerateSets(
+      const Board& board,
+      std::vector<BoardSet>& sets);
+
+   static CardCode thirdCard(
+      const CardCode c0,
+      const CardCode c1);
+
+private:
+   static void solveBoards(
+      void* voidArg);
+
+private:
+   ThreadPool::ThreadPool _threadPool;
+};
+
+} // namespace SetGame
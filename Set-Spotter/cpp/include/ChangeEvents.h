@@ -0,0 +1,149 @@
+//
+//  ChangeEvents.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include "SetGame.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+const int DEFAULT_CHANGE_EVENT_DEBOUNCE_FRAMES = 3;
+
+enum class ChangeEventType : uint8_t {
+   CARD_APPEARED = 0,
+   CARD_DISAPPEARED = 1,
+   CARD_RECLASSIFIED = 2,
+   SET_FOUND = 3,
+   SET_LOST = 4
+};
+
+const std::vector<std::string> CHANGE_EVENT_TYPE_TO_STRING = {
+   "CARD_APPEARED", "CARD_DISAPPEARED", "CARD_RECLASSIFIED", "SET_FOUND", "SET_LOST" };
+
+/**
+ * A fixed-size change to the cards or sets in view.  Card events name one
+ * card by its id in cardIds[0] and carry its code (and, when it was
+ * reclassified, the code it had before).  Set events name the set's three
+ * cards by id, ascending, and leave the codes zero.
+ */
+struct ChangeEvent {
+   uint32_t frameNumber;
+   ChangeEventType type;
+   SetGame::CardCode code;
+   SetGame::CardCode previousCode;
+   uint8_t reserved;
+   uint32_t cardIds[3];
+};
+
+/**
+ * Where a card was seen in a frame: its center and the square root of its
+ * area, in frame coordinates.
+ */
+struct CardObservation {
+   SetGame::CardCode code;
+   float x;
+   float y;
+   float size;
+};
+
+/**
+ * Turns the cards seen in each frame into a stream of changes.
+ *
+ * Cards are matched to the ones seen before by position, so a card keeps
+ * the same id while it stays on the table even if it moves a little or is
+ * briefly misread.  A change is only reported once it has held for the
+ * debounce window: a card has to be seen (with the same code) for that
+ * many frames in a row to appear or be reclassified, and missed for that
+ * many to disappear, so a static scene produces no events at all.
+ *
+ * Sets are found among the reported cards, so set events always refer to
+ * cards the consumer has been told about.  Within a frame sets that were
+ * lost come first, then card events, then sets that were found.
+ */
+class ChangeEventTracker {
+public:
+   ChangeEventTracker(int debounceFrames = DEFAULT_CHANGE_EVENT_DEBOUNCE_FRAMES) :
+      _debounceFrames(std::max(debounceFrames, 1)) {}
+
+   // Replaces the contents of events with what changed since the last update
+   void update(
+      const std::vector<CardObservation>& observations,
+      std::vector<ChangeEvent>& events);
+
+   /**
+    * Events that build the current state from nothing, for a consumer that
+    * starts listening part way through: an appearance for every reported
+    * card and a found event for every set among them.
+    */
+   void snapshot(
+      std::vector<ChangeEvent>& events) const;
+
+   // Forgets every card, ids keep counting up so they're never reused
+   void reset();
+
+   int GetDebounceFrames() const { return _debounceFrames; }
+
+   // 1 reports every change immediately
+   void SetDebounceFrames(int frames) { _debounceFrames = std::max(frames, 1); }
+
+   int GetNumTrackedCards() const { return _tracks.size(); }
+
+private:
+   struct Track {
+      uint32_t id;
+      bool reported;
+      SetGame::CardCode code; // As last reported
+      SetGame::CardCode pendingCode; // Code seen in the last pendingFrames frames
+      int pendingFrames;
+      int missedFrames;
+      float x;
+      float y;
+      float size;
+   };
+
+   typedef std::array<uint32_t, 3> SetIds; // Ascending
+
+   void matchObservations(
+      const std::vector<CardObservation>& observations);
+
+   void observe(
+      Track& track,
+      const CardObservation& observation,
+      std::vector<ChangeEvent>& cardEvents) const;
+
+   void findSets(
+      std::vector<SetIds>& sets);
+
+   ChangeEvent cardEvent(
+      const ChangeEventType type,
+      const Track& track) const;
+
+   ChangeEvent setEvent(
+      const ChangeEventType type,
+      const SetIds& set) const;
+
+private:
+   int _debounceFrames;
+   uint32_t _frameNumber = 0;
+   uint32_t _nextId = 0;
+   std::vector<Track> _tracks;
+   std::vector<SetIds> _sets; // Among reported cards, sorted
+
+   // Scratch for update, kept so the steady state doesn't allocate
+   std::vector<int> _trackObservation; // Per track, the matched observation or -1
+   std::vector<bool> _observationMatched;
+   std::vector<std::tuple<float, int, int>> _candidates; // Distance, track, observation
+   std::vector<ChangeEvent> _cardEvents;
+   std::vector<std::pair<SetGame::CardCode, uint32_t>> _reported; // Code and id, sorted
+   std::vector<SetIds> _newSets;
+};
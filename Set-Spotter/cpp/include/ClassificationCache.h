@@ -0,0 +1,142 @@
+//
+//  ClassificationCache.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include "SetGame.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <array>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+const int SIGNATURE_WIDTH = 8;
+const int SIGNATURE_HEIGHT = 12;
+const int SIGNATURE_SIZE = SIGNATURE_WIDTH * SIGNATURE_HEIGHT * 3;
+
+const int DEFAULT_CLASSIFICATION_CACHE_CAPACITY = 128;
+
+/**
+ * An entry is only trusted for this many frames after the card was
+ * classified, then the card is classified again, so a misclassification
+ * that got cached can't outlive it.
+ */
+const int DEFAULT_CLASSIFICATION_CACHE_MAX_AGE_FRAMES = 30;
+
+/**
+ * A cheap perceptual fingerprint of a rectified card patch: the patch
+ * downsampled to SIGNATURE_WIDTH x SIGNATURE_HEIGHT with each BGR channel
+ * quantized to a few bits.  Color is kept because two cards that differ
+ * only in color look almost identical in grayscale.
+ */
+struct CardSignature {
+   std::array<uint8_t, SIGNATURE_SIZE> values;
+   uint64_t hash;
+};
+
+/**
+ * Where a card was seen: its normalized quad and the mean color of the
+ * frame inside the quad's bounding box.  Both are cheap to get without
+ * warping the card.
+ */
+struct CardPlacement {
+   std::vector<cv::Point> quad;
+   cv::Scalar regionMean;
+};
+
+/**
+ * LRU cache mapping card signatures to previously classified cards so a
+ * card that's still on the table (even if it's been bumped) doesn't have
+ * its shapes classified again.
+ *
+ * A card that hasn't moved since the last frame is found by its placement
+ * (lookupPlacement), which needs no rectified patch.  Only cards that moved
+ * pay for a warp and a signature (lookup).  Entries expire maxAgeFrames
+ * after they were inserted, whichever way they're hit.
+ */
+class ClassificationCache {
+public:
+   ClassificationCache(
+      int capacity = DEFAULT_CLASSIFICATION_CACHE_CAPACITY,
+      int maxAgeFrames = DEFAULT_CLASSIFICATION_CACHE_MAX_AGE_FRAMES) :
+         _capacity(capacity),
+         _maxAgeFrames(maxAgeFrames) {}
+
+   // Call once per frame before any lookups
+   void beginFrame() { _frameNumber++; }
+
+   std::optional<SetGame::Card> lookupPlacement(
+      const CardPlacement& placement,
+      const int contourIndex);
+
+   std::optional<SetGame::Card> lookup(
+      const CardSignature& signature,
+      const CardPlacement& placement,
+      const int contourIndex);
+
+   void insert(
+      const CardSignature& signature,
+      const CardPlacement& placement,
+      const SetGame::Card& card);
+
+   void clear();
+
+   int GetHits() const { return _hits; }
+
+   // Hits that didn't need a signature, included in GetHits
+   int GetPlacementHits() const { return _placementHits; }
+
+   int GetMisses() const { return _misses; }
+
+   double GetHitRate() const;
+
+   int GetMaxAgeFrames() const { return _maxAgeFrames; }
+
+   void SetMaxAgeFrames(int frames) { _maxAgeFrames = frames; }
+
+   static CardSignature computeSignature(
+      const cv::Mat& cardPatch);
+
+   static CardPlacement computePlacement(
+      const cv::Mat& frame,
+      const std::vector<cv::Point>& quad);
+
+private:
+   struct Entry {
+      CardSignature signature;
+      CardPlacement placement;
+      SetGame::Shape shape;
+      int count;
+      int insertedFrame;
+      int seenFrame; // Last frame the entry was hit or inserted in
+   };
+
+   bool expired(
+      const Entry& entry) const;
+
+   SetGame::Card hit(
+      std::list<Entry>::iterator it,
+      const CardPlacement& placement,
+      const int contourIndex);
+
+   static bool samePlacement(
+      const CardPlacement& placement1,
+      const CardPlacement& placement2);
+
+private:
+   int _capacity;
+   int _maxAgeFrames;
+   int _frameNumber = 0;
+   std::list<Entry> _entries; // Most recently used first
+   std::unordered_map<uint64_t, std::list<Entry>::iterator> _index;
+   int _hits = 0;
+   int _placementHits = 0;
+   int _misses = 0;
+};
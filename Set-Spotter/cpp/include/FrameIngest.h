@@ -0,0 +1,143 @@
+//
+//  FrameIngest.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include "FrameProcessor.h"
+#include "SessionCapture.h"
+#include "SetGame.h"
+#include "ShmRing.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * Shared-Memory Frame Ingest
+ *
+ * A local producer (a capture process or camera driver shim) writes frames
+ * straight into the slots of a frame ring and the daemon processes them
+ * where they lie: each slot is wrapped in a cv::Mat without copying and
+ * handed to FrameProcessor::Process.  The slot goes back to the producer
+ * only once the frame has been processed, so a slow daemon pushes back on
+ * the producer instead of queueing frames without bound.
+ *
+ * Each frame slot holds an IngestFrameHeader followed by the pixels.  Each
+ * result slot holds an IngestResult truncated after its last set.
+ *
+ * Timestamps are steady_clock nanoseconds, which on Linux is
+ * CLOCK_MONOTONIC and so comparable between processes on the same machine.
+ */
+const int MAX_RESULT_CARDS = 81;
+const int MAX_RESULT_SETS = 1080; // Every set in a full deck
+const uint32_t DEFAULT_INGEST_SLOTS = 4;
+const uint64_t DEFAULT_MAX_FRAME_BYTES = 1920 * 1080 * 3;
+
+struct alignas(SHM_RING_ALIGNMENT) IngestFrameHeader {
+   uint64_t frameId;
+   int64_t captureNanos;
+   int32_t rows;
+   int32_t cols;
+   int32_t type;
+   uint32_t step;
+};
+
+struct IngestResult {
+   uint64_t frameId;
+   int64_t captureNanos;
+   int64_t publishNanos;
+   float processMillis;
+   uint8_t partial;
+   uint8_t reserved;
+   uint16_t numCards;
+   uint32_t numSets;
+   SetGame::CardCode cards[MAX_RESULT_CARDS];
+   RecordedSet sets[MAX_RESULT_SETS];
+};
+
+struct IngestStats {
+   uint64_t numFrames = 0;
+   uint64_t numInvalidFrames = 0;
+   uint64_t numDroppedResults = 0; // Results lost because nobody drained the result ring
+   uint64_t numCancelledFrames = 0; // Frames abandoned because a newer frame arrived
+   uint64_t numSkippedFrames = 0; // Stale frames dropped unprocessed in favor of the newest
+   double processMillis = 0;
+};
+
+int64_t ingestClockNanos();
+
+// Bytes of a result slot in use for the given number of sets
+inline uint64_t
+ingestResultSize(
+   const uint32_t numSets)
+{
+   return offsetof(IngestResult, sets) + numSets * sizeof(RecordedSet);
+}
+
+/**
+ * Backs off from spinning to sleeping while a ring is empty or full, so an
+ * idle daemon doesn't burn a core but a busy one reacts within microseconds.
+ */
+class RingBackoff {
+public:
+   void wait();
+
+   void reset() { _numWaits = 0; }
+
+private:
+   int _numWaits = 0;
+};
+
+class FrameIngestDaemon {
+public:
+   // Creates both rings; producers and result readers open them by name
+   FrameIngestDaemon(
+      FrameProcessor& frameProcessor,
+      const std::string& frameRingName,
+      const std::string& resultRingName,
+      const uint32_t numSlots = DEFAULT_INGEST_SLOTS,
+      const uint64_t maxFrameBytes = DEFAULT_MAX_FRAME_BYTES);
+
+   FrameIngestDaemon(const FrameIngestDaemon&) = delete;
+   FrameIngestDaemon& operator=(const FrameIngestDaemon&) = delete;
+
+   /**
+    * Process frames until stop is set.  When cancelling stale frames, each
+    * frame taken from the ring is the newest one queued (older ones are
+    * dropped unprocessed) and a watcher thread cancels the frame being
+    * processed, once, as soon as a newer one is waiting, so workers always
+    * spend their time on the freshest frame.  The newest frame is never
+    * cancelled, so under sustained load results keep coming.  Cancelled
+    * frames publish no result.
+    */
+   void run(
+      const std::atomic<bool>& stop);
+
+   // Process the next frame if one is waiting.  Returns whether it did.
+   bool processNext();
+
+   const IngestStats& GetStats() const { return _stats; }
+
+   bool GetCancelStaleFrames() const { return _cancelStaleFrames; }
+
+   void SetCancelStaleFrames(bool cancel) { _cancelStaleFrames = cancel; }
+
+private:
+   void publishResult(
+      const IngestFrameHeader& frameHeader,
+      const double processMillis);
+
+private:
+   FrameProcessor& _frameProcessor;
+   ShmRing _frameRing;
+   ShmRing _resultRing;
+   IngestStats _stats;
+   bool _cancelStaleFrames = false;
+   std::atomic<int> _inFlightFrame = -1; // The processor's number for the frame in flight, -1 between frames
+};
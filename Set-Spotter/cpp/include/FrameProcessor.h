@@ -7,11 +7,20 @@
 
 #pragma once
 
+#include "AllocationTracker.h"
+#include "ChangeEvents.h"
+#include "ClassificationCache.h"
+#include "IncrementalSetSolver.h"
 #include "SetGame.h"
+#include "SymbolClassifier.h"
 #include "ThreadPool.h"
 
 #include <opencv2/opencv.hpp>
 
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <pthread.h>
 #include <unordered_map>
 #include <unordered_set>
@@ -20,27 +29,239 @@
 namespace tp = ThreadPool;
 
 typedef std::vector<cv::Point> Contour;
-typedef std::tuple<int, Contour> IndexedContour;
 
-class ClassifyShapeArg : public tp::PoolTaskArg<std::vector<IndexedContour>> {
+/**
+ * Membership of contours in a filtered group (cards, shapes), indexed by
+ * contour index and sized to the frame's contour count.  Filtering passes
+ * contour indices around and tests them against these instead of copying
+ * contours.
+ */
+typedef std::vector<bool> ContourBitmap;
+
+class SessionRecorder;
+
+enum class ProcessStage {
+   PREPROCESS = 0,
+   CONTOURS = 1,
+   FILTER = 2,
+   CLASSIFY = 3,
+   SETS = 4,
+   HIGHLIGHT = 5
+};
+
+const int NUM_PROCESS_STAGES = 6;
+
+const std::vector<std::string> PROCESS_STAGE_TO_STRING = {
+   "PREPROCESS", "CONTOURS", "FILTER", "CLASSIFY", "SETS", "HIGHLIGHT" };
+
+typedef std::array<double, NUM_PROCESS_STAGES> StageTimings;
+
+typedef std::array<AllocationTracker::AllocationStats, NUM_PROCESS_STAGES> StageAllocations;
+
+/**
+ * How a shape's color and shading are measured.  MASKED draws the shape's
+ * border band, fill and the ring around its outline as masks the size of
+ * the frame and averages every pixel under them.  SPARSE reads a few dozen
+ * pixels on rays from the shape's center through evenly spaced points of
+ * its outline, at depths inside the same bands, and takes robust statistics
+ * of them instead, so its cost doesn't depend on the size of the shape or
+ * of the frame.
+ */
+enum class ShapeSamplingMode {
+   MASKED,
+   SPARSE
+};
+
+const std::vector<std::string> SHAPE_SAMPLING_MODE_TO_STRING = { "MASKED", "SPARSE" };
+
+class ClassifyShapeArg : public tp::PoolTaskArg<std::vector<int>> {
 public:
    ClassifyShapeArg(
+      const std::vector<Contour>& _contours,
       const std::vector<cv::Vec4i>& _hierarchy,
       cv::Mat& _frame,
       std::unordered_map<int, std::vector<SetGame::Shape>>& _cardIndexToShapesMap,
-      pthread_mutex_t* _mapMutex) :
+      pthread_mutex_t* _mapMutex,
+      const std::chrono::steady_clock::time_point _deadline,
+      std::unordered_set<int>* _approximatedCards,
+      const ShapeSamplingMode _samplingMode) :
+         contours(_contours),
          hierarchy(_hierarchy),
          frame(_frame),
          cardIndexToShapesMap(_cardIndexToShapesMap),
-         mapMutex(_mapMutex) {}
+         mapMutex(_mapMutex),
+         deadline(_deadline),
+         approximatedCards(_approximatedCards),
+         samplingMode(_samplingMode) {}
 
    ClassifyShapeArg() = delete;
 
+   const std::vector<Contour>& contours; // Read-only, the elements are indices into it
    const std::vector<cv::Vec4i>& hierarchy; // Read-only
    cv::Mat& frame; // Read-only
    std::unordered_map<int, std::vector<SetGame::Shape>>&
       cardIndexToShapesMap; // Write
    pthread_mutex_t* mapMutex;
+   const std::chrono::steady_clock::time_point deadline; // Read-only
+   std::unordered_set<int>* approximatedCards; // Write, cards with a shape approximated or copied
+   const ShapeSamplingMode samplingMode;
+};
+
+/**
+ * PER_SHAPE fully classifies every shape.  PER_CARD fully classifies only
+ * the largest shape on each card and checks the rest against it.
+ * RECTIFIED warps each card to a small canonical patch and finds and
+ * classifies its shapes there, so the cost per card doesn't depend on the
+ * camera's resolution or angle.  CARD_LOCAL gives the same results as
+ * PER_SHAPE but makes each card one task: the card's shapes are read from
+ * its own children in the contour tree and sampled from its own crop of
+ * the frame, so nothing between finding cards and classifying them walks
+ * every contour in the frame.  RECTIFIED and CARD_LOCAL are opt-in
+ * (SetClassificationMode) until replaying a capture with them shows no
+ * mismatches against the mode they'd replace.
+ */
+enum class ClassificationMode {
+   PER_SHAPE,
+   PER_CARD,
+   RECTIFIED,
+   CARD_LOCAL
+};
+
+const std::vector<std::string> CLASSIFICATION_MODE_TO_STRING = { "PER_SHAPE", "PER_CARD", "RECTIFIED", "CARD_LOCAL" };
+
+class ClassifyCardArg : public tp::PoolTaskArg<std::vector<int>> {
+public:
+   ClassifyCardArg(
+      const cv::Mat& _frame,
+      const std::unordered_map<int, Contour>& _cardQuads,
+      const std::unordered_map<int, cv::Mat>& _cardPatches,
+      std::unordered_map<int, std::vector<SetGame::Shape>>& _cardIndexToShapesMap,
+      pthread_mutex_t* _mapMutex,
+      const ShapeSamplingMode _samplingMode) :
+         frame(_frame),
+         cardQuads(_cardQuads),
+         cardPatches(_cardPatches),
+         cardIndexToShapesMap(_cardIndexToShapesMap),
+         mapMutex(_mapMutex),
+         samplingMode(_samplingMode) {}
+
+   ClassifyCardArg() = delete;
+
+   const cv::Mat& frame; // Read-only
+   const std::unordered_map<int, Contour>& cardQuads; // Read-only
+   const std::unordered_map<int, cv::Mat>& cardPatches; // Read-only, patches rectified for the cache lookup
+   std::unordered_map<int, std::vector<SetGame::Shape>>&
+      cardIndexToShapesMap; // Write
+   pthread_mutex_t* mapMutex;
+   const ShapeSamplingMode samplingMode;
+};
+
+class LocalCardArg : public tp::PoolTaskArg<std::vector<int>> {
+public:
+   LocalCardArg(
+      const cv::Mat& _frame,
+      const std::vector<Contour>& _contours,
+      const std::vector<cv::Vec4i>& _hierarchy,
+      const float _minShapeArea,
+      const float _maxShapeArea,
+      std::unordered_map<int, std::vector<SetGame::Shape>>& _cardIndexToShapesMap,
+      pthread_mutex_t* _mapMutex,
+      const std::chrono::steady_clock::time_point _deadline,
+      std::unordered_set<int>* _approximatedCards,
+      const ShapeSamplingMode _samplingMode) :
+         frame(_frame),
+         contours(_contours),
+         hierarchy(_hierarchy),
+         minShapeArea(_minShapeArea),
+         maxShapeArea(_maxShapeArea),
+         cardIndexToShapesMap(_cardIndexToShapesMap),
+         mapMutex(_mapMutex),
+         deadline(_deadline),
+         approximatedCards(_approximatedCards),
+         samplingMode(_samplingMode) {}
+
+   LocalCardArg() = delete;
+
+   const cv::Mat& frame; // Read-only
+   const std::vector<Contour>& contours; // Read-only, in frame coordinates
+   const std::vector<cv::Vec4i>& hierarchy; // Read-only
+   const float minShapeArea;
+   const float maxShapeArea;
+   std::unordered_map<int, std::vector<SetGame::Shape>>&
+      cardIndexToShapesMap; // Write
+   pthread_mutex_t* mapMutex;
+   const std::chrono::steady_clock::time_point deadline; // Read-only
+   std::unordered_set<int>* approximatedCards; // Write, cards with shapes copied to meet the deadline
+   const ShapeSamplingMode samplingMode;
+};
+
+/**
+ * A highlight tile covers the bounding box of every stroke drawn around a
+ * single card.  The alpha channel marks which pixels of the tile belong to
+ * a stroke so the tile can be blended onto a frame without redrawing it.
+ */
+struct OverlayTile {
+   cv::Rect roi;
+   cv::Mat bgra;
+};
+
+/**
+ * Rendered set highlights from a previous frame along with the key they
+ * were rendered for: the frame size and, for each set in sorted order,
+ * the quads of its three cards.
+ */
+struct HighlightOverlay {
+   cv::Size frameSize;
+   std::vector<std::array<Contour, 3>> setQuads;
+   std::vector<OverlayTile> tiles;
+};
+
+/**
+ * Processing profiles trade accuracy for latency.
+ *
+ * FAST: contours are found on a half-resolution frame and only one shape
+ * per card is fully classified.
+ * BALANCED: contours are found at 3/4 resolution, one shape per card is
+ * fully classified, and one thread is left free for camera capture and UI.
+ * ACCURATE: full resolution, every shape is fully classified.
+ */
+enum class ProcessingProfile {
+   FAST = 0,
+   BALANCED = 1,
+   ACCURATE = 2
+};
+
+const std::vector<std::string> PROCESSING_PROFILE_TO_STRING = { "FAST", "BALANCED", "ACCURATE" };
+
+struct ProfileSettings {
+   float detectionScale;
+   ClassificationMode classificationMode;
+   int threadsHeldBack; // Workers left idle, the pool always keeps at least one
+};
+
+const std::vector<ProfileSettings> PROFILE_SETTINGS = {
+   { 0.5, ClassificationMode::PER_CARD, 0 },
+   { 0.75, ClassificationMode::PER_CARD, 1 },
+   { 1.0, ClassificationMode::PER_SHAPE, 0 }
+};
+
+typedef std::tuple<int, int> RowBand; // [start, end)
+
+class ThresholdBandArg : public tp::PoolTaskArg<std::vector<RowBand>> {
+public:
+   ThresholdBandArg(
+      const cv::Mat& _frame,
+      cv::Mat& _threshold,
+      const int _blockSize) :
+         frame(_frame),
+         threshold(_threshold),
+         blockSize(_blockSize) {}
+
+   ThresholdBandArg() = delete;
+
+   const cv::Mat& frame; // Read-only
+   cv::Mat& threshold; // Write, each band writes only its own rows
+   const int blockSize;
 };
 
 class FrameProcessor {
@@ -50,58 +271,289 @@ public:
    _threadPool(maxThreads),
    _showSets(showSets) {}
 
+   FrameProcessor(
+      const tp::ThreadPoolOptions& threadPoolOptions, bool showSets = true) :
+   _threadPool(threadPoolOptions),
+   _showSets(showSets) {}
+
    void Process(cv::Mat& frame);
 
+   /**
+    * Grayscale + adaptive threshold, split into bands across the thread
+    * pool for large frames.  The frame is expected at the current profile's
+    * detection scale.
+    */
+   void Threshold(const cv::Mat& frame, cv::Mat& threshold);
+
    bool GetShowSets() const { return _showSets; }
 
    void SetShowSets(bool show) { _showSets = show; }
 
    int GetNumSetsInFrame() const { return _numSetsInFrame; }
 
+   const std::vector<SetGame::Card>& GetCardsInFrame() const { return _cardsInFrame; }
+
+   const std::vector<SetGame::Set>& GetSetsInFrame() const { return _setsInFrame; }
+
+   // Milliseconds spent in each ProcessStage during the last call to Process
+   const StageTimings& GetStageMillis() const { return _stageMillis; }
+
+   /**
+    * Allocations made during each ProcessStage of the last call to Process,
+    * and the most memory that was live above what was live when Process
+    * started.  Only collected while AllocationTracker is enabled.
+    */
+   const StageAllocations& GetStageAllocations() const { return _stageAllocations; }
+
+   int64_t GetPeakScratchBytes() const { return _peakScratchBytes; }
+
+   // Every processed frame is appended to the recorder until this is set back to null
+   void SetSessionRecorder(SessionRecorder* recorder) { _sessionRecorder = recorder; }
+
+   /**
+    * Off by default until its hit rate and mismatches against uncached
+    * classification have been measured on a capture (ReplayBenchmark
+    * --cache).
+    */
+   bool GetUseClassificationCache() const { return _useClassificationCache; }
+
+   void SetUseClassificationCache(bool use) { _useClassificationCache = use; }
+
+   const ClassificationCache& GetClassificationCache() const { return _classificationCache; }
+
+   tp::ParallelizeStats GetParallelizeStats() const { return _threadPool.GetParallelizeStats(); }
+
+   ClassificationMode GetClassificationMode() const { return _classificationMode; }
+
+   void SetClassificationMode(ClassificationMode mode) { _classificationMode = mode; }
+
+   ShapeSamplingMode GetShapeSamplingMode() const { return _shapeSamplingMode; }
+
+   void SetShapeSamplingMode(ShapeSamplingMode mode) { _shapeSamplingMode = mode; }
+
+   ProcessingProfile GetProfile() const { return _profile; }
+
+   void SetProfile(ProcessingProfile profile);
+
+   double GetDeadlineMillis() const { return _deadlineMillis; }
+
+   // 0 disables the deadline
+   void SetDeadlineMillis(double deadlineMillis) { _deadlineMillis = deadlineMillis; }
+
+   // True if shapes in the last frame were approximated to meet the deadline
+   bool GetFrameIsPartial() const { return _framePartial; }
+
+   /**
+    * Contour indices of the cards in the last frame whose shapes were
+    * approximated, or copied from another shape on the card, to meet the
+    * deadline.  They're still reported in GetCardsInFrame, with attributes
+    * that are a best guess, but sets are only found among the other cards.
+    */
+   const std::unordered_set<int>& GetApproximatedCards() const { return _approximatedCards; }
+
+   /**
+    * Abandon the given frame, for example because a newer frame has
+    * arrived.  Safe to call from any thread and does nothing if that frame
+    * isn't the one being processed, so a caller that raced with the next
+    * Process can't cancel the newer frame.  Queued work for the frame is
+    * dropped, running work stops at the next card or shape, and Process
+    * returns with no cards or sets.
+    */
+   void CancelFrame(int frameNumber);
+
+   // The number the next call to Process gives its frame
+   int GetNextFrameNumber() const { return _frameNumber; }
+
+   // True if the last frame was cancelled before it finished
+   bool GetFrameWasCancelled() const { return _frameCancelled; }
+
+   /**
+    * Forget everything carried from one frame to the next (card and shape
+    * area limits, cached card classifications, last frame's sets, the
+    * highlight overlay and tracked cards) so the next frame is processed as
+    * if it were the first.
+    */
+   void ResetStream();
+
+   bool GetEmitChangeEvents() const { return _emitChangeEvents; }
+
+   // Turning events off forgets every tracked card
+   void SetEmitChangeEvents(bool emit);
+
+   /**
+    * What changed in the cards and sets in view during the last call to
+    * Process, debounced by the change event tracker.  Empty unless change
+    * events are on, and for cancelled frames, which aren't tracked.
+    */
+   const std::vector<ChangeEvent>& GetChangeEvents() const { return _changeEvents; }
+
+   const ChangeEventTracker& GetChangeEventTracker() const { return _changeEventTracker; }
+
+   int GetChangeEventDebounceFrames() const { return _changeEventTracker.GetDebounceFrames(); }
+
+   void SetChangeEventDebounceFrames(int frames) { _changeEventTracker.SetDebounceFrames(frames); }
+
 private:
    /**
     * ================
     * Instance Methods
     * ================
     */
+   void processFrame(
+      cv::Mat& frame);
+
+   void endStage(
+      const ProcessStage stage,
+      std::chrono::steady_clock::time_point& stageStart);
+
    bool cardFilter(
-      const IndexedContour& indexedContour,
+      const int index,
       const std::vector<Contour>& contours,
       const std::vector<cv::Vec4i>& hierarchy,
-      std::unordered_set<int>& cardIndices) const;
+      ContourBitmap& isCard,
+      std::unordered_map<int, Contour>& cardQuads) const;
 
    bool shapeFilter(
-      const IndexedContour& indexedContour,
+      const int index,
+      const std::vector<Contour>& contours,
       const std::vector<cv::Vec4i>& hierarchy,
-      const std::unordered_set<int>& cardIndices) const;
-
-   std::vector<SetGame::Set> getSortedSets(
-      const std::vector<SetGame::Card> indexedCards) const;
+      const ContourBitmap& isCard) const;
 
    void highlightSets(
       cv::Mat& frame,
       const std::vector<SetGame::Set>& sets,
-      const std::vector<Contour>& contours) const;
+      const std::vector<Contour>& contours,
+      const std::unordered_map<int, Contour>& cardQuads);
+
+   bool overlayMatches(
+      const cv::Size& frameSize,
+      const std::vector<std::array<Contour, 3>>& setQuads) const;
+
+   void renderOverlay(
+      const cv::Size& frameSize,
+      const std::vector<SetGame::Set>& sets,
+      const std::vector<Contour>& contours);
+
+   void blendOverlay(
+      cv::Mat& frame) const;
+
+   void classifyRectifiedCards(
+      std::vector<int>& cardIndices,
+      const cv::Mat& frame,
+      const std::unordered_map<int, Contour>& cardQuads,
+      const std::unordered_map<int, cv::Mat>& cardPatches,
+      std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapesMap);
+
+   void classifyCardsLocally(
+      std::vector<int>& cardIndices,
+      const cv::Mat& frame,
+      const std::vector<Contour>& contours,
+      const std::vector<cv::Vec4i>& hierarchy,
+      std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapesMap);
+
+   void classifyShapesInParallel(
+      std::vector<int>& shapeIndices,
+      const std::vector<Contour>& contours,
+      const std::vector<cv::Vec4i>& hierarchy,
+      cv::Mat& frame,
+      std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapesMap);
+
+   void classifyRepresentativeShapes(
+      const std::vector<int>& shapeIndices,
+      const std::vector<Contour>& contours,
+      const std::vector<cv::Vec4i>& hierarchy,
+      cv::Mat& frame,
+      std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapesMap);
 
    /**
     * ==============
     * Static Methods
     * ==============
     */
+   static int scaledBlockSize(
+      const float scale);
+
+   static void thresholdBands(
+      void* voidArg);
+
    static void classifyShapes(
       void* voidArg);
 
+   static void approximateShape(
+      const int contourIndex,
+      const Contour& contour,
+      const SetGame::Symbol symbol,
+      const std::vector<cv::Vec4i>& hierarchy,
+      const cv::Mat& frame,
+      std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapeMap,
+      pthread_mutex_t* mapMutex,
+      const ShapeSamplingMode samplingMode);
+
    static void classifyShape(
-      const IndexedContour& indexedShape,
+      const int contourIndex,
+      const Contour& contour,
+      const SetGame::Symbol symbol,
       const std::vector<cv::Vec4i>& hierarchy,
       const cv::Mat& frame,
       std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapeMap,
-      pthread_mutex_t* mapMutex);
+      pthread_mutex_t* mapMutex,
+      const ShapeSamplingMode samplingMode);
+
+   static SetGame::Shape sampleShape(
+      const Contour& contour,
+      const SetGame::Symbol symbol,
+      const cv::Mat& frame,
+      const ShapeSamplingMode samplingMode,
+      const float minBandWidth);
+
+   static SetGame::Shape sampleShapeMasked(
+      const Contour& contour,
+      const SetGame::Symbol symbol,
+      const cv::Mat& frame,
+      const float minBandWidth);
+
+   static SetGame::Shape sampleShapeSparse(
+      const Contour& contour,
+      const SetGame::Symbol symbol,
+      const cv::Mat& frame,
+      const float minBandWidth);
+
+   static SetGame::Color classifyColor(
+      const cv::Scalar& borderColor);
+
+   static SetGame::Shading classifyShading(
+      const cv::Scalar& outlineColor,
+      const cv::Scalar& fillColor);
+
+   static void classifyCards(
+      void* voidArg);
+
+   static std::vector<SetGame::Shape> classifyCardPatch(
+      const cv::Mat& cardPatch,
+      const ShapeSamplingMode samplingMode);
+
+   static void classifyLocalCards(
+      void* voidArg);
+
+   static bool isShapeContour(
+      const Contour& contour,
+      const float minShapeArea,
+      const float maxShapeArea);
+
+   static int approxVertexCount(
+      const Contour& contour);
 
    static void scaleContour(
       Contour& contour,
       const float scalar);
 
+   static cv::Mat rectifyCard(
+      const cv::Mat& frame,
+      const Contour& quad);
+
+   static void normalizeQuad(
+      Contour& quad);
+
    static cv::Point scalePoint(
       const cv::Point& point,
       const int cx,
@@ -119,11 +571,40 @@ private:
 
 private:
    bool _initialized = false;
+   cv::Size _frameSize; // The size the area limits were computed for
    tp::ThreadPool _threadPool;
    float _minCardArea = 0;
    float _maxCardArea = 0;
    float _minShapeArea = 0;
    float _maxShapeArea = 0;
-   int _numSetsInFrame;
+   int _numSetsInFrame = 0;
+   std::vector<SetGame::Card> _cardsInFrame;
+   std::vector<SetGame::Set> _setsInFrame;
+   std::vector<SetGame::Set> _setScratch; // Last frame's sets, reused as the solver's output
+   StageTimings _stageMillis = {};
+   StageAllocations _stageAllocations = {};
+   AllocationTracker::Snapshot _stageAllocationStart;
+   int64_t _peakScratchBytes = 0;
+   SessionRecorder* _sessionRecorder = nullptr;
    bool _showSets = true;
+   HighlightOverlay _overlay;
+   bool _useClassificationCache = false;
+   ClassificationCache _classificationCache;
+   SetGame::IncrementalSetSolver _setSolver;
+   ClassificationMode _classificationMode = ClassificationMode::PER_SHAPE;
+   ShapeSamplingMode _shapeSamplingMode = ShapeSamplingMode::MASKED;
+   ProcessingProfile _profile = ProcessingProfile::ACCURATE;
+   float _detectionScale = 1.0;
+   double _deadlineMillis = 0;
+   std::chrono::steady_clock::time_point _classifyDeadline;
+   bool _framePartial = false;
+   std::unordered_set<int> _approximatedCards; // Guarded by the classification map mutex while classifying
+   int _frameNumber = 0;
+   bool _frameCancelled = false;
+   std::shared_ptr<tp::TaskGroup> _frameTaskGroup; // Null between frames
+   std::mutex _frameTaskGroupMutex;
+   bool _emitChangeEvents = false;
+   std::vector<CardObservation> _cardObservations; // Where each card in view was seen, when emitting
+   std::vector<ChangeEvent> _changeEvents;
+   ChangeEventTracker _changeEventTracker;
 };
@@ -0,0 +1,77 @@
+//
+//  IncrementalSetSolver.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include "SetGame.h"
+
+#include <array>
+#include <vector>
+
+namespace SetGame {
+
+typedef std::array<CardCode, 3> SetCodes; // Ascending
+
+/**
+ * Finds the sets among the cards in view, reusing the sets found for the
+ * previous cards.
+ *
+ * Sets are tracked as triples of card codes.  Whether a triple is a set
+ * depends only on which codes are present (and, for three copies of the
+ * same card, on there being at least three), so when a few cards are added
+ * or removed only the triples containing a changed code are dropped and
+ * looked up again: each changed code paired with every present code, with
+ * the third card read from a table.  When most codes changed every triple
+ * is looked up again instead.
+ *
+ * The triples are then expanded into Set objects for the cards in view and
+ * sorted with sortSets, which gives the same order as sorting a full
+ * recompute.  Once the solver and the output vector have grown to the
+ * number of cards and sets in view, updates don't allocate.
+ */
+class IncrementalSetSolver {
+public:
+   // Replaces the contents of sets with the sets among cards
+   void update(
+      const std::vector<Card>& cards,
+      std::vector<Set>& sets);
+
+   void reset();
+
+   int GetNumIncrementalUpdates() const { return _numIncrementalUpdates; }
+
+   int GetNumFullUpdates() const { return _numFullUpdates; }
+
+   /**
+    * Sort sets by their cards and, for sets of identical cards, by the
+    * cards' contour indices so the order doesn't depend on the order the
+    * sets were found in.
+    */
+   static void sortSets(
+      std::vector<Set>& sets);
+
+private:
+   void recomputeAll(
+      const std::array<int, NUM_CARD_CODES>& counts);
+
+   void recomputeChanged(
+      const std::array<int, NUM_CARD_CODES>& counts,
+      const std::array<bool, NUM_CARD_CODES>& changed);
+
+   static bool present(
+      const std::array<int, NUM_CARD_CODES>& counts,
+      const CardCode code) { return counts[code] > 0; }
+
+private:
+   std::array<int, NUM_CARD_CODES> _counts = {};
+   std::vector<SetCodes> _setCodes;
+   std::vector<int> _positions; // Card positions grouped by code, scratch for update
+   int _numIncrementalUpdates = 0;
+   int _numFullUpdates = 0;
+};
+
+} // namespace SetGame
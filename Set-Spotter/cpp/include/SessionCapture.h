@@ -0,0 +1,157 @@
+//
+//  SessionCapture.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include "FrameProcessor.h"
+#include "SetGame.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * Capture File Format
+ *
+ * A capture is append-only and made up of:
+ *
+ *   SessionFileHeader
+ *   Frame record 0
+ *   ...
+ *   Frame record n - 1
+ *   uint64_t index[n]     (file offset of every frame record)
+ *   SessionFileFooter
+ *
+ * Each frame record is a FrameRecordHeader followed by the frame payload
+ * (raw pixels or a PNG), the recorded cards as CardCodes and the recorded
+ * sets as CardCode triples, padded to a multiple of 8 bytes.
+ *
+ * The index and footer are only written when the recorder is closed.  If
+ * a capture was cut short the records can still be found by walking them
+ * from the start of the file.
+ */
+const std::array<char, 8> SESSION_FILE_MAGIC = { 'S', 'S', 'C', 'A', 'P', '0', '0', '1' };
+const std::array<char, 8> SESSION_FOOTER_MAGIC = { 'S', 'S', 'I', 'D', 'X', '0', '0', '1' };
+const uint32_t FRAME_RECORD_MAGIC = 0x454d5246; // "FRME"
+const uint32_t SESSION_FILE_VERSION = 1;
+
+enum class FrameEncoding : uint32_t {
+   RAW = 0,
+   PNG = 1
+};
+
+struct SessionFileHeader {
+   std::array<char, 8> magic;
+   uint32_t version;
+   uint32_t reserved;
+};
+
+struct FrameRecordHeader {
+   uint32_t magic;
+   FrameEncoding encoding;
+   int32_t rows;
+   int32_t cols;
+   int32_t type;
+   uint32_t numCards;
+   uint32_t numSets;
+   uint32_t reserved;
+   uint64_t payloadSize;
+   double timestampMillis;
+   StageTimings stageMillis;
+};
+
+struct SessionFileFooter {
+   uint64_t indexOffset;
+   uint64_t numFrames;
+   std::array<char, 8> magic;
+};
+
+typedef std::array<SetGame::CardCode, 3> RecordedSet;
+
+/**
+ * A frame read back from a capture.  For RAW captures "frame" is a
+ * read-only view into the mapped file.
+ */
+struct RecordedFrame {
+   const FrameRecordHeader* header;
+   cv::Mat frame;
+   std::vector<SetGame::CardCode> cards;
+   std::vector<RecordedSet> sets;
+};
+
+struct ReplayReport {
+   int numFrames = 0;
+   int numMismatchedFrames = 0;
+   int numPartialFrames = 0; // Frames where shapes were approximated to meet the deadline
+   int numApproximatedCards = 0; // Cards left out of set finding because their shapes were approximated
+   double fps = 0;
+   double p50Millis = 0;
+   double p99Millis = 0;
+   double jitterMillis = 0;
+};
+
+class SessionRecorder {
+public:
+   SessionRecorder(
+      const std::string& path,
+      FrameEncoding encoding = FrameEncoding::RAW);
+   ~SessionRecorder();
+
+   void append(
+      const cv::Mat& frame,
+      const FrameProcessor& frameProcessor);
+
+   void close();
+
+private:
+   std::ofstream _file;
+   FrameEncoding _encoding;
+   std::vector<uint64_t> _index;
+   std::chrono::steady_clock::time_point _start;
+};
+
+class SessionReplay {
+public:
+   SessionReplay(const std::string& path);
+   ~SessionReplay();
+
+   SessionReplay(const SessionReplay&) = delete;
+   SessionReplay& operator=(const SessionReplay&) = delete;
+
+   int GetNumFrames() const { return _offsets.size(); }
+
+   RecordedFrame getFrame(
+      const int frameIndex) const;
+
+   /**
+    * Feed every recorded frame to the frame processor, either paced by the
+    * recorded timestamps or as fast as possible, and compare the cards and
+    * sets it finds with the ones that were recorded.
+    */
+   ReplayReport run(
+      FrameProcessor& frameProcessor,
+      bool recordedRate = false) const;
+
+   static std::vector<SetGame::CardCode> encodeCards(
+      const std::vector<SetGame::Card>& cards);
+
+   static std::vector<RecordedSet> encodeSets(
+      const std::vector<SetGame::Set>& sets);
+
+private:
+   void buildIndex();
+
+private:
+   int _fd = -1;
+   const uint8_t* _data = nullptr;
+   size_t _size = 0;
+   std::vector<uint64_t> _offsets;
+};
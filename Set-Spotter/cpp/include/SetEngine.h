@@ -0,0 +1,295 @@
+//
+//  SetEngine.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+namespace SetGame {
+
+/**
+ * Set rules for a deck with NumAttributes attributes that each take Arity
+ * values.  A set is Arity cards where every attribute is all the same or
+ * all different; the standard game is SetEngine<4, 3>.
+ *
+ * A card is a base-Arity number with one digit per attribute (least
+ * significant first).  Everything that depends on the deck's shape is
+ * worked out at compile time, so for Arity 3 the card completing a pair is
+ * a single lookup in a constexpr table (or, for decks too large for one,
+ * straight-line digit arithmetic) and finding sets needs no attribute
+ * comparisons.
+ */
+template <int NumAttributes, int Arity = 3>
+class SetEngine {
+public:
+   static_assert(NumAttributes >= 1, "a deck needs at least one attribute");
+   static_assert(Arity >= 3 && Arity <= 8, "attributes take 3 to 8 values");
+
+   static constexpr int NUM_ATTRIBUTES = NumAttributes;
+   static constexpr int ARITY = Arity;
+
+   static constexpr int
+   power(
+      const int base,
+      const int exponent)
+   {
+      int result = 1;
+      for (int i = 0; i < exponent; i++) {
+         result *= base;
+      }
+
+      return result;
+   }
+
+   static constexpr int NUM_CODES = power(Arity, NumAttributes);
+
+   // Smallest type that holds every code and INVALID_CODE
+   typedef std::conditional_t<(NUM_CODES < 0x100), uint8_t,
+      std::conditional_t<(NUM_CODES < 0x10000), uint16_t, uint32_t>> Code;
+
+   static constexpr Code INVALID_CODE = NUM_CODES;
+
+   // Each attribute's value, 0 to Arity - 1
+   typedef std::array<uint8_t, NumAttributes> Attributes;
+
+   static constexpr Code
+   encode(
+      const Attributes& attributes)
+   {
+      int code = 0;
+      for (int attribute = NumAttributes - 1; attribute >= 0; attribute--) {
+         code = code * Arity + attributes[attribute];
+      }
+
+      return code;
+   }
+
+   static constexpr Attributes
+   decode(
+      Code code)
+   {
+      Attributes attributes {};
+      for (int attribute = 0; attribute < NumAttributes; attribute++) {
+         attributes[attribute] = code % Arity;
+         code /= Arity;
+      }
+
+      return attributes;
+   }
+
+   /**
+    * The card that makes a set with the Arity - 1 given cards, or
+    * INVALID_CODE if none does.  For each attribute the given values have
+    * to be all the same, in which case the last card shares the value, or
+    * all different, in which case it takes the one value that's missing.
+    */
+   static constexpr Code
+   complete(
+      const std::array<Code, Arity - 1>& codes)
+   {
+      int code = 0;
+      int place = 1;
+      for (int attribute = 0; attribute < NumAttributes; attribute++) {
+         int values = 0;
+         int sum = 0;
+         for (const Code c : codes) {
+            const int value = (c / place) % Arity;
+            values |= 1 << value;
+            sum += value;
+         }
+
+         const int numDistinct = std::popcount((unsigned)values);
+         if (numDistinct == 1) {
+            code += sum / (Arity - 1) * place;
+         } else if (numDistinct == Arity - 1) {
+            code += (Arity * (Arity - 1) / 2 - sum) * place;
+         } else {
+            return INVALID_CODE;
+         }
+         place *= Arity;
+      }
+
+      return code;
+   }
+
+   /**
+    * For Arity 3 the completing card always exists: each digit is
+    * (-(d0 + d1)) mod 3.  Decks up to MAX_TABLE_CODES cards look it up in a
+    * table built at compile time.
+    */
+   static constexpr int MAX_TABLE_CODES = 243;
+   static constexpr bool HAS_THIRD_CARD_TABLE = Arity == 3 && NUM_CODES <= MAX_TABLE_CODES;
+
+   static constexpr int TABLE_CODES = HAS_THIRD_CARD_TABLE ? NUM_CODES : 1;
+   typedef std::array<std::array<Code, TABLE_CODES>, TABLE_CODES> ThirdCardTable;
+
+   static constexpr ThirdCardTable
+   makeThirdCardTable()
+   {
+      ThirdCardTable table {};
+      for (int c0 = 0; c0 < TABLE_CODES; c0++) {
+         for (int c1 = 0; c1 < TABLE_CODES; c1++) {
+            table[c0][c1] = thirdCardArithmetic(c0, c1);
+         }
+      }
+
+      return table;
+   }
+
+   static constexpr Code
+   thirdCard(
+      const Code c0,
+      const Code c1) requires (Arity == 3)
+   {
+      if constexpr (HAS_THIRD_CARD_TABLE) {
+         return THIRD_CARD_TABLE[c0][c1];
+      } else {
+         return thirdCardArithmetic(c0, c1);
+      }
+   }
+
+   static constexpr bool
+   isSet(
+      const std::array<Code, Arity>& codes)
+   {
+      if constexpr (Arity == 3) {
+         return thirdCard(codes[0], codes[1]) == codes[2];
+      } else {
+         std::array<Code, Arity - 1> first {};
+         for (int i = 0; i < Arity - 1; i++) {
+            first[i] = codes[i];
+         }
+         return complete(first) == codes[Arity - 1];
+      }
+   }
+
+   /**
+    * Call fn with the positions (ascending) of every set among n distinct
+    * cards.  Each set is found once, from its first Arity - 1 cards: the
+    * completing card has to be present and come after them.
+    */
+   static constexpr int MAX_POSITION_TABLE_CODES = 19683;
+
+   template <typename Fn>
+   static void
+   forEachSet(
+      const Code* codes,
+      const int n,
+      Fn&& fn)
+   {
+      static_assert(NUM_CODES <= MAX_POSITION_TABLE_CODES, "deck too large for a position table");
+      // Distinct cards means fewer than NUM_CODES positions
+      typedef std::conditional_t<(NUM_CODES <= 0x80), int8_t, int16_t> Position;
+      std::array<Position, NUM_CODES + 1> position;
+      position.fill(-1); // Including INVALID_CODE's entry
+      for (int i = 0; i < n; i++) {
+         position[codes[i]] = i;
+      }
+
+      if constexpr (Arity == 3) {
+         for (int i = 0; i < n; i++) {
+            for (int j = i + 1; j < n; j++) {
+               const int k = position[thirdCard(codes[i], codes[j])];
+               if (k > j) {
+                  const std::array<int, 3> positions { i, j, k };
+                  fn(positions);
+               }
+            }
+         }
+      } else {
+         if (n < Arity) return;
+
+         // Walk every combination of Arity - 1 positions in order
+         std::array<int, Arity> positions {};
+         for (int i = 0; i < Arity - 1; i++) {
+            positions[i] = i;
+         }
+         while (true) {
+            std::array<Code, Arity - 1> first {};
+            for (int i = 0; i < Arity - 1; i++) {
+               first[i] = codes[positions[i]];
+            }
+            const int last = position[complete(first)];
+            if (last > positions[Arity - 2]) {
+               positions[Arity - 1] = last;
+               fn(positions);
+            }
+
+            int i = Arity - 2;
+            while (i >= 0 && positions[i] == n - (Arity - 1) + i) i--;
+            if (i < 0) break;
+            positions[i]++;
+            for (int j = i + 1; j < Arity - 1; j++) {
+               positions[j] = positions[j - 1] + 1;
+            }
+         }
+      }
+   }
+
+   // Number of sets among n distinct cards
+   static int
+   countSets(
+      const Code* codes,
+      const int n)
+   {
+      if constexpr (Arity == 3) {
+         // The third card of each pair just has to be present and larger than both
+         std::array<uint64_t, (NUM_CODES + 63) / 64> present {};
+         for (int i = 0; i < n; i++) {
+            present[codes[i] >> 6] |= uint64_t(1) << (codes[i] & 63);
+         }
+
+         int count = 0;
+         for (int i = 0; i < n; i++) {
+            const Code c0 = codes[i];
+            for (int j = i + 1; j < n; j++) {
+               const Code c1 = codes[j];
+               const Code c2 = thirdCard(c0, c1);
+               count += (c2 > std::max(c0, c1)) & (int)((present[c2 >> 6] >> (c2 & 63)) & 1);
+            }
+         }
+
+         return count;
+      } else {
+         int count = 0;
+         forEachSet(codes, n, [&](const std::array<int, Arity>&) { count++; });
+         return count;
+      }
+   }
+
+private:
+   static constexpr Code
+   thirdCardArithmetic(
+      const int c0,
+      const int c1)
+   {
+      int code = 0;
+      int place = 1;
+      for (int attribute = 0; attribute < NumAttributes; attribute++) {
+         code += ((6 - (c0 / place) % 3 - (c1 / place) % 3) % 3) * place;
+         place *= 3;
+      }
+
+      return code;
+   }
+
+   // Defined below, once the class is complete; only instantiated for engines that use it
+   static const ThirdCardTable THIRD_CARD_TABLE;
+};
+
+template <int NumAttributes, int Arity>
+constexpr typename SetEngine<NumAttributes, Arity>::ThirdCardTable
+   SetEngine<NumAttributes, Arity>::THIRD_CARD_TABLE = SetEngine<NumAttributes, Arity>::makeThirdCardTable();
+
+// The standard 81-card game: count, color, symbol and shading
+typedef SetEngine<4, 3> StandardSetEngine;
+
+} // namespace SetGame
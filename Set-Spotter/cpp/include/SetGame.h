@@ -7,12 +7,18 @@
 
 #pragma once
 
+#include "SetEngine.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <type_traits>
 
 namespace SetGame {
 
-enum class Color {
+enum class Color : uint8_t {
    RED = 0,
    GREEN = 1,
    PURPLE = 2,
@@ -21,7 +27,7 @@ enum class Color {
 
 const std::vector<std::string> COLOR_TO_STRING = { "RED", "GREEN", "PURPLE", "UNKNOWN" };
 
-enum class Symbol {
+enum class Symbol : uint8_t {
    DIAMOND = 0,
    SQUIGGLE = 1,
    OVAL = 2,
@@ -30,7 +36,7 @@ enum class Symbol {
 
 const std::vector<std::string> SYMBOL_TO_STRING = { "DIAMOND", "SQUIGGLE", "OVAL", "UNKNOWN" };
 
-enum class Shading {
+enum class Shading : uint8_t {
    SOLID = 0,
    STRIPED = 1,
    OPEN = 2,
@@ -39,6 +45,11 @@ enum class Shading {
 
 const std::vector<std::string> SHADING_TO_STRING = { "SOLID", "STRIPED", "OPEN", "UNKNOWN" };
 
+/**
+ * Shape, Card and Set are small trivially copyable values: a card is 8
+ * bytes and a set holds its three cards inline, so finding, copying and
+ * sorting sets never touches the heap.  toString is for logging only.
+ */
 struct Shape {
    Shape(Color color, Symbol symbol, Shading shading) :
       color(color), symbol(symbol), shading(shading) {}
@@ -58,30 +69,66 @@ struct Card {
    Card(Shape shape, int count, int contourIndex) :
       shape(shape), count(count), contourIndex(contourIndex) {}
 
+   // Orders by card code
    bool operator<(const Card& other) const;
 
    std::string toString() const;
 
    Shape shape;
-   int count;
-   int contourIndex;
+   uint8_t count;
+   int32_t contourIndex;
 };
 
+/**
+ * A set holds copies of its cards (24 bytes) rather than 8-bit indices
+ * into the frame's card vector.  Sets outlive that vector: the overlay,
+ * change events, batch records and Python callers read a set's codes and
+ * contour indices after the cards it was found in have been replaced, so
+ * indices would have to travel with a copy of the vector anyway.
+ */
 struct Set {
-   Set(std::vector<Card> cards) : cards(cards) {
-      std::sort(this->cards.begin(), this->cards.end());
-   }
+   // Cards are kept sorted by code, then contour index
+   Set(const std::array<Card, 3>& cards);
 
    static bool isSet(
       const Card& c0,
       const Card& c1,
       const Card& c2);
 
+   // Orders by the cards' codes
    bool operator<(const Set& other) const;
 
    std::string toString() const;
 
-   std::vector<Card> cards;
+   std::array<Card, 3> cards;
 };
 
+/**
+ * A card packed into a single base-3 number: count, color, symbol and
+ * shading each contribute one digit (least significant first), so the
+ * 81 cards of a standard deck map to codes 0-80.  These are
+ * StandardSetEngine's codes, so its tables apply to them directly.
+ */
+typedef StandardSetEngine::Code CardCode;
+
+const int NUM_CARD_CODES = StandardSetEngine::NUM_CODES;
+
+inline CardCode
+encodeCard(
+   const Card& card)
+{
+   return (card.count - 1) +
+      3 * static_cast<int>(card.shape.color) +
+      9 * static_cast<int>(card.shape.symbol) +
+      27 * static_cast<int>(card.shape.shading);
+}
+
+Card decodeCard(const CardCode code, const int contourIndex = -1);
+
+static_assert(StandardSetEngine::encode({ 2, 0, 1, 2 }) == 2 + 9 + 54,
+   "encodeCard's digit order should match the engine's");
+
+static_assert(sizeof(Card) == 8, "cards should stay packed");
+static_assert(std::is_trivially_copyable_v<Set>, "sets should be plain values");
+
 } // namespace SetGame
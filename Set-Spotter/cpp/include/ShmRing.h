@@ -0,0 +1,114 @@
+//
+//  ShmRing.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+const uint64_t SHM_RING_MAGIC = 0x474e495253505353; // "SSPSRING"
+const uint32_t SHM_RING_VERSION = 1;
+const int SHM_RING_ALIGNMENT = 64;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring sequence counters must be lock-free");
+
+/**
+ * Shared Memory Ring Layout
+ *
+ *   ShmRingHeader
+ *   Slot 0:       ShmSlotHeader, payload (slotSize bytes)
+ *   ...
+ *   Slot n - 1
+ *
+ * Each slot header and the start of each payload are aligned to a cache
+ * line.  The ring hands slots between one producer and one consumer
+ * without locks: every slot has a sequence counter and the position
+ * counters only ever increase.  For position p in slot p % n:
+ *
+ *   sequence == p      the slot is free and the producer may fill it
+ *   sequence == p + 1  the slot is full and the consumer may read it
+ *
+ * The producer publishes a filled slot by storing p + 1 and the consumer
+ * frees it by storing p + n, both with release ordering, so the payload is
+ * always visible before the slot changes hands.
+ */
+struct ShmRingHeader {
+   uint64_t magic;
+   uint32_t version;
+   uint32_t numSlots;
+   uint64_t slotSize;
+   uint64_t slotStride;
+   alignas(SHM_RING_ALIGNMENT) std::atomic<uint64_t> writePosition;
+   alignas(SHM_RING_ALIGNMENT) std::atomic<uint64_t> readPosition;
+};
+
+struct alignas(SHM_RING_ALIGNMENT) ShmSlotHeader {
+   std::atomic<uint64_t> sequence;
+   uint64_t size; // Bytes of the payload in use
+};
+
+/**
+ * A single-producer single-consumer ring of fixed-size slots in POSIX
+ * shared memory.  Slots are written and read in place: the producer fills
+ * the payload returned by tryAcquireWrite and publishes it with
+ * commitWrite, and the consumer works on the payload returned by
+ * tryAcquireRead until it calls releaseRead.
+ */
+class ShmRing {
+public:
+   // Create (or replace) the ring.  The creator unlinks it when destroyed.
+   ShmRing(
+      const std::string& name,
+      const uint32_t numSlots,
+      const uint64_t slotSize);
+
+   // Open a ring created by another process
+   ShmRing(
+      const std::string& name);
+
+   ~ShmRing();
+
+   ShmRing(const ShmRing&) = delete;
+   ShmRing& operator=(const ShmRing&) = delete;
+
+   uint32_t GetNumSlots() const { return _header->numSlots; }
+
+   uint64_t GetSlotSize() const { return _header->slotSize; }
+
+   // Slots filled but not yet released by the consumer
+   uint64_t GetNumQueued() const;
+
+   // Returns the next free slot's payload, or null if the ring is full
+   uint8_t* tryAcquireWrite();
+
+   void commitWrite(
+      const uint64_t size);
+
+   // Returns the next full slot's payload, or null if the ring is empty
+   uint8_t* tryAcquireRead(
+      uint64_t& size);
+
+   void releaseRead();
+
+private:
+   void map(
+      const size_t size,
+      const int flags);
+
+   ShmSlotHeader* slot(
+      const uint64_t position) const;
+
+private:
+   std::string _name;
+   bool _owner = false;
+   int _fd = -1;
+   size_t _size = 0;
+   uint8_t* _data = nullptr;
+   ShmRingHeader* _header = nullptr;
+};
@@ -0,0 +1,30 @@
+//
+//  SymbolClassifier.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include "SetGame.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+
+/**
+ * Rule-based symbol classification: a contour that a 4-sided polygon
+ * approximates closely is a diamond, otherwise its solidity (area over
+ * convex hull area) tells squiggles from ovals.
+ */
+class SymbolClassifier {
+public:
+   static SetGame::Symbol classifyByRules(
+      const std::vector<cv::Point>& contour);
+
+   // Replaces the contents of symbols with each contour's symbol
+   static void classifyContours(
+      const std::vector<const std::vector<cv::Point>*>& contours,
+      std::vector<SetGame::Symbol>& symbols);
+};
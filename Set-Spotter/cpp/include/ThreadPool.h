@@ -7,26 +7,105 @@
 
 #pragma once
 
+#include "Trace.h"
+
 #include <pthread.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <queue>
 #include <iostream>
 
 namespace ThreadPool {
 
+// Used when the number of performance cores can't be detected
 const int DEFAULT_NUM_THREADS = 3;
 
+// Size the pool to the number of performance cores
+const int AUTO_NUM_THREADS = 0;
+
+/**
+ * Worker placement options.
+ *
+ * cpuSet and performanceCoresOnly pin workers with pthread_setaffinity_np
+ * and are ignored on platforms without thread affinity (iOS).  niceness is
+ * applied per worker with setpriority on Linux; on Apple platforms it picks
+ * the workers' QoS class instead (< 0: user-interactive, 0: user-initiated,
+ * > 0: utility).
+ */
+struct ThreadPoolOptions {
+   int numThreads = AUTO_NUM_THREADS;
+   std::vector<int> cpuSet {};
+   bool performanceCoresOnly = false; // Use the performance cores as cpuSet
+   bool pinEachWorker = false; // Pin worker i to cpuSet[i % cpuSet.size()] only
+   std::optional<int> niceness {};
+};
+
+/**
+ * capacity is the kernel's relative compute capacity for the CPU (or its
+ * max frequency when capacity isn't exposed).  Performance cores are the
+ * CPUs with the highest capacity.
+ */
+struct CoreInfo {
+   int cpu;
+   long capacity;
+   bool performance;
+};
+
+/**
+ * Tasks submitted together, typically all the work for one frame.  Queued
+ * tasks of higher priority groups run first, and tasks of equal priority
+ * run in the order they were queued.  Cancelling a group (with
+ * ThreadPool::cancelGroup) drops its queued tasks; tasks already running
+ * are expected to check isCancelled and return early.
+ */
+class TaskGroup {
+public:
+   TaskGroup(int priority = 0) : _priority(priority) {}
+
+   int GetPriority() const { return _priority; }
+
+   bool isCancelled() const { return _cancelled.load(std::memory_order_relaxed); }
+
+   void cancel() { _cancelled.store(true, std::memory_order_relaxed); }
+
+private:
+   int _priority;
+   std::atomic<bool> _cancelled { false };
+};
+
 template <typename T>
 struct PoolTaskArg {
    typename T::iterator start;
    typename T::iterator end;
+   const TaskGroup* group = nullptr; // Set by parallelize
+
+   bool isCancelled() const { return group != nullptr && group->isCancelled(); }
 };
 
 enum class PoolTaskStatus {
    NOT_STARTED,
    RUNNING,
    FAILED,
-   SUCCEEDED
+   SUCCEEDED,
+   CANCELLED
+};
+
+/**
+ * Counters describing how parallelize has been running work, along with
+ * the cost model it uses to decide.
+ */
+struct ParallelizeStats {
+   long inlineRuns = 0;
+   long pooledRuns = 0;
+   long probeRuns = 0; // Pooled runs that were predicted to be faster inline
+   std::vector<long> partitionCounts; // Index = number of partitions used
+   double nanosPerCostUnit = 0; // 0 until the first run with a cost function
+   double dispatchNanos = 0; // Per-partition handoff cost
 };
 
 class PoolTask {
@@ -37,55 +116,162 @@ public:
    void(*func)(void*);
    void* arg;
    bool threadCancelled = false;
+   std::shared_ptr<TaskGroup> group; // Optional
+   uint64_t sequence = 0; // Queue order among tasks of equal priority
+   int64_t runNanos = 0;
    PoolTaskStatus status;
    pthread_mutex_t statusMutex;
    pthread_cond_t statusCond;
 };
 
+// Orders the queue by group priority, then first in first out
+struct PoolTaskOrder {
+   bool operator()(const PoolTask* a, const PoolTask* b) const {
+      const int aPriority = a->group ? a->group->GetPriority() : 0;
+      const int bPriority = b->group ? b->group->GetPriority() : 0;
+      if (aPriority != bPriority) return aPriority < bPriority;
+      return a->sequence > b->sequence;
+   }
+};
+
+typedef std::priority_queue<PoolTask*, std::vector<PoolTask*>, PoolTaskOrder> PoolTaskQueue;
+
 class ThreadPool {
 public:
-   ThreadPool(int numThreads=DEFAULT_NUM_THREADS);
+   ThreadPool(int numThreads=AUTO_NUM_THREADS);
+   ThreadPool(const ThreadPoolOptions& options);
    ~ThreadPool();
 
    void enqueue(PoolTask* const task);
 
+   /**
+    * Split the container into partitions and run targetFn on each one in
+    * the pool.  If costFn is given it's used to predict the work in the
+    * container: work too small to be worth handing off to another thread
+    * runs on the calling thread, and otherwise the number of partitions is
+    * chosen to minimize predicted latency.  Safe to call from several
+    * threads at once, they share the pool's cost model.
+    *
+    * Tasks are queued in the current task group (see SetTaskGroup).  Returns
+    * CANCELLED if the group was cancelled before every partition finished,
+    * in which case some partitions may not have run; otherwise SUCCEEDED.
+    */
    template <typename T>
-   void parallelize(
+   PoolTaskStatus parallelize(
       void(*targetFn)(void*),
       T& container,
-      std::function<PoolTaskArg<T>*()> getArgFn);
+      std::function<PoolTaskArg<T>*()> getArgFn,
+      std::function<double(const typename T::value_type&)> costFn = nullptr);
 
+   // Blocks until the task succeeds, fails or is cancelled
    PoolTaskStatus waitForTask(PoolTask* const task) const;
 
+   /**
+    * Cancel the group and drop its queued tasks, waking anyone waiting on
+    * them.  Safe to call from any thread.
+    */
+   void cancelGroup(const std::shared_ptr<TaskGroup>& group);
+
+   // Group for the tasks parallelize queues, null for none
+   void SetTaskGroup(std::shared_ptr<TaskGroup> group) { _taskGroup = std::move(group); }
+
+   int GetNumThreads() const { return _numThreads; }
+
+   int GetActiveThreads() const { return _activeThreads; }
+
+   // Limit how many workers parallelize spreads work across (1 to GetNumThreads())
+   void SetActiveThreads(int activeThreads) {
+      _activeThreads = std::max(1, std::min(activeThreads, _numThreads));
+   }
+
+   // A copy, the stats keep changing while other threads call parallelize
+   ParallelizeStats GetParallelizeStats() const;
+
    static int partition(const int n, const int x);
 
+   static std::vector<CoreInfo> detectCores();
+
+   static int numPerformanceCores();
+
    friend void* startThread(void* arg);
 
 private:
+   void placeWorker(
+      pthread_t thread,
+      const int workerIndex) const;
+
+   int choosePartitions(
+      const double totalCost,
+      const int numElements);
+
+   void recordRun(
+      const int numPartitions,
+      const double totalCost,
+      const int64_t runNanos,
+      const int64_t wallNanos);
+
+private:
+   ThreadPoolOptions _options;
    int _numThreads;
+   int _activeThreads;
    std::vector<pthread_t> _threads;
-   std::queue<PoolTask* const> _queue;
+   PoolTaskQueue _queue;
+   uint64_t _nextSequence = 0; // Guarded by _queueMutex
+   std::shared_ptr<TaskGroup> _taskGroup;
    pthread_mutex_t _queueMutex;
    pthread_cond_t _queueCond;
+   mutable pthread_mutex_t _statsMutex; // Guards _stats and _inlineRunsSinceProbe
+   ParallelizeStats _stats;
+   int _inlineRunsSinceProbe = 0;
 };
 
 template <typename T>
-void
+PoolTaskStatus
 ThreadPool::parallelize(
    void(*targetFn)(void*),
    T& container,
-   std::function<PoolTaskArg<T>*()> getArgFn)
+   std::function<PoolTaskArg<T>*()> getArgFn,
+   std::function<double(const typename T::value_type&)> costFn)
 {
+   TRACE_SPAN("ThreadPool::parallelize");
+   if (_taskGroup && _taskGroup->isCancelled()) return PoolTaskStatus::CANCELLED;
+
    const int numElements = container.size();
-   const int partitionSize = numElements <= _numThreads ? 1 :
-      numElements / _numThreads;
+   int numPartitions = std::min(numElements, _activeThreads);
+   double totalCost = 0;
+   if (costFn && numElements > 0) {
+      for (const auto& element : container) {
+         totalCost += costFn(element);
+      }
+      numPartitions = choosePartitions(totalCost, numElements);
+   }
+
+   // Only the work and the handoffs are timed, not the cost function
+   auto wallStart = std::chrono::steady_clock::now();
+
+   if (numPartitions == 0 && numElements > 0) {
+      // Predicted work is smaller than the cost of a handoff--run it here
+      PoolTaskArg<T>* arg = getArgFn();
+      arg->start = container.begin();
+      arg->end = container.end();
+      arg->group = _taskGroup.get();
+      targetFn(arg);
+      delete arg;
+
+      std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - wallStart;
+      recordRun(0, totalCost, elapsed.count(), elapsed.count());
+      return _taskGroup && _taskGroup->isCancelled() ? PoolTaskStatus::CANCELLED : PoolTaskStatus::SUCCEEDED;
+   }
+
+   const int partitionSize = numElements <= numPartitions ? 1 :
+      numElements / numPartitions;
    const int bigPartitionSize = partitionSize + 1;
-   const int numBigPartitions = partition(numElements, _numThreads);
+   const int numBigPartitions = partition(numElements, numPartitions);
    std::vector<PoolTask*> tasks;
    int elementIndex = 0;
    int threadIndex = 0;
    try {
-      while (elementIndex < numElements && threadIndex < _numThreads) {
+      while (elementIndex < numElements && threadIndex < numPartitions) {
          int start;
          int end;
          if (threadIndex < numBigPartitions) {
@@ -98,9 +284,11 @@ ThreadPool::parallelize(
 
          PoolTask* task = new PoolTask;
          task->func = targetFn;
+         task->group = _taskGroup;
          PoolTaskArg<T>* arg = getArgFn();
          arg->start = container.begin() + start;
          arg->end = container.begin() + end;
+         arg->group = _taskGroup.get();
          task->arg = arg;
          tasks.push_back(task);
 
@@ -114,18 +302,31 @@ ThreadPool::parallelize(
       std::cout << "Exception occurred" << std::endl;
    }
 
+   int64_t runNanos = 0;
+   bool cancelled = false;
    for (PoolTask* task : tasks) {
       PoolTaskStatus status = waitForTask(task);
 
       if (status == PoolTaskStatus::FAILED) {
          throw std::runtime_error("Task failed");
       }
+      cancelled |= status == PoolTaskStatus::CANCELLED;
 
       // Task succeeded, clean up resources
+      runNanos += task->runNanos;
       PoolTaskArg<T>* tArgPtr = (PoolTaskArg<T>*)task->arg;
       delete tArgPtr;
       delete task;
    }
+
+   // Cancelled runs would skew the cost model
+   cancelled |= _taskGroup && _taskGroup->isCancelled();
+   if (costFn && !tasks.empty() && !cancelled) {
+      std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - wallStart;
+      recordRun(tasks.size(), totalCost, runNanos, elapsed.count());
+   }
+
+   return cancelled ? PoolTaskStatus::CANCELLED : PoolTaskStatus::SUCCEEDED;
 }
 
 } // namespace ThreadPool
@@ -0,0 +1,87 @@
+//
+//  Trace.h
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+/**
+ * Opt-in timeline tracing.
+ *
+ * Spans are recorded into a fixed-size ring buffer owned by the thread that
+ * records them, so recording never takes a lock.  Trace::dump writes every
+ * buffered span as Chrome trace-event JSON, which can be loaded in
+ * chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Tracing is compiled in only when SET_SPOTTER_TRACING is defined (Debug
+ * builds) and, when compiled in, records nothing until Trace::setEnabled
+ * is called.  dump should be called while traced threads are idle; spans
+ * recorded during a dump may be torn.
+ */
+namespace Trace {
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+const int THREAD_BUFFER_CAPACITY = 16384;
+
+extern std::atomic<bool> enabled;
+
+inline bool
+isEnabled()
+{
+   return enabled.load(std::memory_order_relaxed);
+}
+
+void setEnabled(bool enable);
+
+void recordSpan(
+   const char* name,
+   const TimePoint& start,
+   const TimePoint& end);
+
+void recordInstant(
+   const char* name);
+
+bool dump(
+   const std::string& path);
+
+class Span {
+public:
+   Span(const char* name) : _name(name), _active(isEnabled()) {
+      if (_active) _start = std::chrono::steady_clock::now();
+   }
+
+   ~Span() {
+      if (_active) recordSpan(_name, _start, std::chrono::steady_clock::now());
+   }
+
+   Span(const Span&) = delete;
+   Span& operator=(const Span&) = delete;
+
+private:
+   const char* _name;
+   bool _active;
+   TimePoint _start;
+};
+
+} // namespace Trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef SET_SPOTTER_TRACING
+#define TRACE_SPAN(name) Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+#define TRACE_INSTANT(name) do { if (Trace::isEnabled()) Trace::recordInstant(name); } while (0)
+#define TRACE_RECORD_SPAN(name, start, end) \
+   do { if (Trace::isEnabled()) Trace::recordSpan(name, start, end); } while (0)
+#else
+#define TRACE_SPAN(name) do {} while (0)
+#define TRACE_INSTANT(name) do {} while (0)
+#define TRACE_RECORD_SPAN(name, start, end) do {} while (0)
+#endif
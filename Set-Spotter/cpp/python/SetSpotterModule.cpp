@@ -0,0 +1,220 @@
+//
+//  SetSpotterModule.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Python bindings for offline evaluation, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -shared -fPIC -Iinclude python/SetSpotterModule.cpp src/*.cpp $(python3 -m pybind11 --includes) $(pkg-config --cflags --libs opencv4) -lpthread -lrt -o set_spotter$(python3-config --extension-suffix)
+//
+//  Frames are C-contiguous NumPy uint8 arrays of shape (height, width, 3) in
+//  BGR order, as returned by cv2.imread.  They're wrapped as cv::Mat views
+//  without a copy and processed with the GIL released; arrays that would
+//  need converting are rejected rather than copied.  Results come back as NumPy
+//  structured arrays (see BatchFrameProcessor.h for the fields):
+//
+//    import set_spotter
+//    batch = set_spotter.BatchFrameProcessor(threads=8, profile=set_spotter.ProcessingProfile.ACCURATE)
+//    frames, cards, sets = batch.process_batch([cv2.imread(p) for p in paths])
+//    cards[cards["frame_index"] == 3]["code"]
+//
+
+#include "BatchFrameProcessor.h"
+#include "FrameProcessor.h"
+#include "SetGame.h"
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <chrono>
+#include <tuple>
+
+namespace py = pybind11;
+
+// Any NumPy array, checked by toMat; pybind11 never converts or copies it
+typedef py::array FrameArray;
+
+/**
+ * Wrap a C-contiguous (height, width, 3) uint8 array as a cv::Mat, which
+ * is what cv2 and most image loaders give.  Anything else would need a
+ * converted copy, and processing a copy would drop the highlights drawn on
+ * the frame, so it's rejected instead.
+ */
+static cv::Mat
+toMat(
+   FrameArray& array)
+{
+   if (!py::isinstance<py::array_t<uint8_t>>(array)) {
+      throw std::runtime_error("Frames must be uint8 arrays, got " + std::string(py::str(array.dtype())));
+   }
+   if (array.ndim() != 3 || array.shape(2) != 3) {
+      throw std::runtime_error("Frames must have shape (height, width, 3)");
+   }
+   if (!(array.flags() & py::array::c_style)) {
+      throw std::runtime_error("Frames must be C-contiguous");
+   }
+   if (!array.writeable()) {
+      throw std::runtime_error("Frames must be writeable");
+   }
+
+   return cv::Mat(array.shape(0), array.shape(1), CV_8UC3, array.mutable_data());
+}
+
+// Hand a result vector to NumPy without copying it
+template <typename T>
+static py::array_t<T>
+toArray(
+   std::vector<T>&& records)
+{
+   auto* owned = new std::vector<T>(std::move(records));
+   py::capsule owner(owned, [](void* vector) { delete (std::vector<T>*)vector; });
+
+   return py::array_t<T>(owned->size(), owned->data(), owner);
+}
+
+static py::tuple
+toArrays(
+   BatchResults&& results)
+{
+   return py::make_tuple(
+      toArray(std::move(results.frames)),
+      toArray(std::move(results.cards)),
+      toArray(std::move(results.sets)));
+}
+
+PYBIND11_MODULE(set_spotter, module) {
+   module.doc() = "Set-Spotter frame processing";
+
+   PYBIND11_NUMPY_DTYPE_EX(BatchFrameRecord,
+      frameIndex, "frame_index", numCards, "num_cards", numSets, "num_sets",
+      partial, "partial", reserved, "reserved", processMillis, "process_millis");
+   PYBIND11_NUMPY_DTYPE_EX(BatchCardRecord,
+      frameIndex, "frame_index", contourIndex, "contour_index", code, "code", count, "count",
+      color, "color", symbol, "symbol", shading, "shading", reserved, "reserved");
+   PYBIND11_NUMPY_DTYPE_EX(BatchSetRecord,
+      frameIndex, "frame_index", contourIndices, "contour_indices", codes, "codes",
+      reserved, "reserved");
+
+   py::enum_<SetGame::Color>(module, "Color")
+      .value("RED", SetGame::Color::RED)
+      .value("GREEN", SetGame::Color::GREEN)
+      .value("PURPLE", SetGame::Color::PURPLE)
+      .value("UNKNOWN", SetGame::Color::UNKNOWN);
+
+   py::enum_<SetGame::Symbol>(module, "Symbol")
+      .value("DIAMOND", SetGame::Symbol::DIAMOND)
+      .value("SQUIGGLE", SetGame::Symbol::SQUIGGLE)
+      .value("OVAL", SetGame::Symbol::OVAL)
+      .value("UNKNOWN", SetGame::Symbol::UNKNOWN);
+
+   py::enum_<SetGame::Shading>(module, "Shading")
+      .value("SOLID", SetGame::Shading::SOLID)
+      .value("STRIPED", SetGame::Shading::STRIPED)
+      .value("OPEN", SetGame::Shading::OPEN)
+      .value("UNKNOWN", SetGame::Shading::UNKNOWN);
+
+   py::enum_<ProcessingProfile>(module, "ProcessingProfile")
+      .value("FAST", ProcessingProfile::FAST)
+      .value("BALANCED", ProcessingProfile::BALANCED)
+      .value("ACCURATE", ProcessingProfile::ACCURATE);
+
+   py::enum_<ShapeSamplingMode>(module, "ShapeSamplingMode")
+      .value("MASKED", ShapeSamplingMode::MASKED)
+      .value("SPARSE", ShapeSamplingMode::SPARSE);
+
+   py::enum_<ChangeEventType>(module, "ChangeEventType")
+      .value("CARD_APPEARED", ChangeEventType::CARD_APPEARED)
+      .value("CARD_DISAPPEARED", ChangeEventType::CARD_DISAPPEARED)
+      .value("CARD_RECLASSIFIED", ChangeEventType::CARD_RECLASSIFIED)
+      .value("SET_FOUND", ChangeEventType::SET_FOUND)
+      .value("SET_LOST", ChangeEventType::SET_LOST);
+
+   py::class_<ChangeEvent>(module, "ChangeEvent")
+      .def_readonly("frame_number", &ChangeEvent::frameNumber)
+      .def_readonly("type", &ChangeEvent::type)
+      .def_readonly("code", &ChangeEvent::code)
+      .def_readonly("previous_code", &ChangeEvent::previousCode)
+      .def_property_readonly("card_ids", [](const ChangeEvent& event) {
+         return std::make_tuple(event.cardIds[0], event.cardIds[1], event.cardIds[2]);
+      });
+
+   py::class_<SetGame::Shape>(module, "Shape")
+      .def(py::init<SetGame::Color, SetGame::Symbol, SetGame::Shading>(),
+         py::arg("color"), py::arg("symbol"), py::arg("shading"))
+      .def_readwrite("color", &SetGame::Shape::color)
+      .def_readwrite("symbol", &SetGame::Shape::symbol)
+      .def_readwrite("shading", &SetGame::Shape::shading)
+      .def("__eq__", &SetGame::Shape::operator==)
+      .def("__repr__", &SetGame::Shape::toString);
+
+   py::class_<SetGame::Card>(module, "Card")
+      .def(py::init<SetGame::Shape, int, int>(),
+         py::arg("shape"), py::arg("count"), py::arg("contour_index") = -1)
+      .def_readwrite("shape", &SetGame::Card::shape)
+      .def_readwrite("count", &SetGame::Card::count)
+      .def_readwrite("contour_index", &SetGame::Card::contourIndex)
+      .def("__repr__", &SetGame::Card::toString);
+
+   py::class_<SetGame::Set>(module, "Set")
+      .def(py::init<std::array<SetGame::Card, 3>>(), py::arg("cards"))
+      .def_readonly("cards", &SetGame::Set::cards)
+      .def_static("is_set", &SetGame::Set::isSet)
+      .def("__repr__", &SetGame::Set::toString);
+
+   module.def("encode_card", &SetGame::encodeCard, py::arg("card"));
+   module.def("decode_card", &SetGame::decodeCard, py::arg("code"), py::arg("contour_index") = -1);
+
+   // Single-stream processing, for live feeds and interactive use
+   py::class_<FrameProcessor>(module, "FrameProcessor")
+      .def(py::init<int, bool>(), py::arg("threads") = tp::AUTO_NUM_THREADS, py::arg("show_sets") = false)
+      .def("process", [](FrameProcessor& frameProcessor, FrameArray frame) {
+         cv::Mat mat = toMat(frame);
+         BatchResults results;
+         {
+            py::gil_scoped_release release;
+            auto start = std::chrono::steady_clock::now();
+            frameProcessor.Process(mat);
+            std::chrono::duration<double, std::milli> processMillis = std::chrono::steady_clock::now() - start;
+            BatchFrameProcessor::appendResults(frameProcessor, 0, processMillis.count(), results);
+         }
+         return py::make_tuple(toArray(std::move(results.cards)), toArray(std::move(results.sets)));
+      }, py::arg("frame"), "Process a frame in place and return (cards, sets) as structured arrays")
+      .def_property_readonly("cards", &FrameProcessor::GetCardsInFrame)
+      .def_property_readonly("sets", &FrameProcessor::GetSetsInFrame)
+      .def_property("show_sets", &FrameProcessor::GetShowSets, &FrameProcessor::SetShowSets)
+      .def_property("profile", &FrameProcessor::GetProfile, &FrameProcessor::SetProfile)
+      .def_property("shape_sampling", &FrameProcessor::GetShapeSamplingMode, &FrameProcessor::SetShapeSamplingMode)
+      .def_property("deadline_millis", &FrameProcessor::GetDeadlineMillis, &FrameProcessor::SetDeadlineMillis)
+      .def_property_readonly("frame_is_partial", &FrameProcessor::GetFrameIsPartial)
+      .def_property_readonly("approximated_cards", &FrameProcessor::GetApproximatedCards)
+      .def("reset_stream", &FrameProcessor::ResetStream, "Process the next frame as if it were the first")
+      .def_property("emit_change_events", &FrameProcessor::GetEmitChangeEvents, &FrameProcessor::SetEmitChangeEvents)
+      .def_property("change_event_debounce_frames", &FrameProcessor::GetChangeEventDebounceFrames,
+         &FrameProcessor::SetChangeEventDebounceFrames)
+      .def_property_readonly("change_events", &FrameProcessor::GetChangeEvents)
+      .def("change_event_snapshot", [](const FrameProcessor& frameProcessor) {
+         std::vector<ChangeEvent> events;
+         frameProcessor.GetChangeEventTracker().snapshot(events);
+         return events;
+      });
+
+   py::class_<BatchFrameProcessor>(module, "BatchFrameProcessor")
+      .def(py::init<int, ProcessingProfile>(),
+         py::arg("threads") = tp::AUTO_NUM_THREADS, py::arg("profile") = ProcessingProfile::ACCURATE)
+      .def_property_readonly("threads", &BatchFrameProcessor::GetNumThreads)
+      .def("process_batch", [](BatchFrameProcessor& batchFrameProcessor, std::vector<FrameArray> frames) {
+         // Keep the arrays alive while the views are in use
+         std::vector<cv::Mat> mats;
+         for (auto& frame : frames) {
+            mats.push_back(toMat(frame));
+         }
+         BatchResults results;
+         {
+            py::gil_scoped_release release;
+            results = batchFrameProcessor.processBatch(mats);
+         }
+         return toArrays(std::move(results));
+      }, py::arg("frames"), "Process a list of frames across the thread pool and return (frames, cards, sets)");
+}
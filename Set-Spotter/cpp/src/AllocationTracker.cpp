@@ -0,0 +1,223 @@
+//
+//  AllocationTracker.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#include "AllocationTracker.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace AllocationTracker {
+
+std::atomic<bool> enabled(false);
+
+namespace {
+
+std::atomic<uint64_t> numAllocations(0);
+std::atomic<uint64_t> bytesAllocated(0);
+std::atomic<int64_t> liveBytes(0);
+std::atomic<int64_t> peakLiveBytes(0);
+
+/**
+ * Wraps OpenCV's standard allocator.  Every UMatData it hands out is
+ * re-pointed at this allocator so the matching deallocation comes back
+ * through here too.
+ */
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+   cv::UMatData*
+   allocate(
+      int dims,
+      const int* sizes,
+      int type,
+      void* data,
+      size_t* step,
+      cv::AccessFlag flags,
+      cv::UMatUsageFlags usageFlags) const override
+   {
+      cv::UMatData* u = cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+      if (u != nullptr) {
+         u->currAllocator = this;
+         // User-provided data isn't owned by the Mat so it isn't counted
+         if (data == nullptr) recordAllocation(u->size);
+      }
+
+      return u;
+   }
+
+   bool
+   allocate(
+      cv::UMatData* u,
+      cv::AccessFlag accessFlags,
+      cv::UMatUsageFlags usageFlags) const override
+   {
+      return cv::Mat::getStdAllocator()->allocate(u, accessFlags, usageFlags);
+   }
+
+   void
+   deallocate(
+      cv::UMatData* u) const override
+   {
+      if (u == nullptr) return;
+
+      // Mirrors the check the standard allocator makes before freeing
+      if (u->refcount == 0 && !(u->flags & cv::UMatData::USER_ALLOCATED)) recordDeallocation(u->size);
+      cv::Mat::getStdAllocator()->deallocate(u);
+   }
+};
+
+CountingMatAllocator matAllocator;
+cv::MatAllocator* previousMatAllocator = nullptr;
+
+} // namespace
+
+void
+setEnabled(
+   bool enable)
+{
+   if (enable == isEnabled()) return;
+
+   if (enable) {
+      previousMatAllocator = cv::Mat::getDefaultAllocator();
+      cv::Mat::setDefaultAllocator(&matAllocator);
+   } else {
+      cv::Mat::setDefaultAllocator(previousMatAllocator);
+   }
+   enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool
+isTrackingHeap()
+{
+#ifdef SET_SPOTTER_ALLOCATION_TRACKING
+   return true;
+#else
+   return false;
+#endif
+}
+
+Snapshot
+snapshot()
+{
+   Snapshot snapshot;
+   snapshot.totals.numAllocations = numAllocations.load(std::memory_order_relaxed);
+   snapshot.totals.bytesAllocated = bytesAllocated.load(std::memory_order_relaxed);
+   snapshot.liveBytes = liveBytes.load(std::memory_order_relaxed);
+   return snapshot;
+}
+
+int64_t
+GetPeakLiveBytes()
+{
+   return peakLiveBytes.load(std::memory_order_relaxed);
+}
+
+void
+resetPeak()
+{
+   peakLiveBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void
+recordAllocation(
+   const uint64_t bytes)
+{
+   numAllocations.fetch_add(1, std::memory_order_relaxed);
+   bytesAllocated.fetch_add(bytes, std::memory_order_relaxed);
+   const int64_t live = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+   int64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+   while (live > peak &&
+          !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+void
+recordDeallocation(
+   const uint64_t bytes)
+{
+   liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+} // namespace AllocationTracker
+
+#ifdef SET_SPOTTER_ALLOCATION_TRACKING
+
+/**
+ * Each block is prefixed with its size so delete knows how many bytes are
+ * being freed.  The prefix is a full max_align_t so the block handed out
+ * keeps malloc's alignment.  Over-aligned new/delete aren't replaced; they
+ * keep using the default implementations as a matched pair.
+ */
+static const size_t BLOCK_HEADER_SIZE = alignof(std::max_align_t);
+
+static void*
+trackedAlloc(
+   size_t size)
+{
+   uint8_t* block = (uint8_t*)std::malloc(size + BLOCK_HEADER_SIZE);
+   if (block == nullptr) return nullptr;
+
+   *(size_t*)block = size;
+   AllocationTracker::recordAllocation(size);
+   return block + BLOCK_HEADER_SIZE;
+}
+
+static void
+trackedFree(
+   void* ptr)
+{
+   if (ptr == nullptr) return;
+
+   uint8_t* block = (uint8_t*)ptr - BLOCK_HEADER_SIZE;
+   AllocationTracker::recordDeallocation(*(size_t*)block);
+   std::free(block);
+}
+
+void*
+operator new(
+   size_t size)
+{
+   void* ptr = trackedAlloc(size);
+   if (ptr == nullptr) throw std::bad_alloc();
+   return ptr;
+}
+
+void*
+operator new[](
+   size_t size)
+{
+   void* ptr = trackedAlloc(size);
+   if (ptr == nullptr) throw std::bad_alloc();
+   return ptr;
+}
+
+void*
+operator new(
+   size_t size,
+   const std::nothrow_t&) noexcept
+{
+   return trackedAlloc(size);
+}
+
+void*
+operator new[](
+   size_t size,
+   const std::nothrow_t&) noexcept
+{
+   return trackedAlloc(size);
+}
+
+void operator delete(void* ptr) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { trackedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { trackedFree(ptr); }
+
+#endif
@@ -0,0 +1,128 @@
+//
+//  BatchFrameProcessor.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#include "BatchFrameProcessor.h"
+
+#include <chrono>
+#include <numeric>
+
+BatchFrameProcessor::BatchFrameProcessor(
+   int numThreads,
+   const ProcessingProfile profile) :
+      _threadPool(numThreads)
+{
+   pthread_mutex_init(&_processorsMutex, NULL);
+   for (int i = 0; i < _threadPool.GetNumThreads(); i++) {
+      _frameProcessors.push_back(std::make_unique<FrameProcessor>(1, false));
+      _frameProcessors.back()->SetProfile(profile);
+   }
+}
+
+BatchFrameProcessor::~BatchFrameProcessor()
+{
+   pthread_mutex_destroy(&_processorsMutex);
+}
+
+BatchResults
+BatchFrameProcessor::processBatch(
+   std::vector<cv::Mat>& frames)
+{
+   for (const auto& frame : frames) {
+      if (frame.empty() || frame.type() != CV_8UC3) {
+         throw std::runtime_error("Batch frames must be non-empty 8-bit BGR images");
+      }
+   }
+
+   std::vector<int> frameIndices(frames.size());
+   std::iota(frameIndices.begin(), frameIndices.end(), 0);
+   std::vector<FrameProcessor*> idleProcessors;
+   for (const auto& frameProcessor : _frameProcessors) {
+      idleProcessors.push_back(frameProcessor.get());
+   }
+   std::vector<BatchResults> frameResults(frames.size());
+
+   // parallelize never runs more partitions than there are workers, so a task can always get a processor
+   _threadPool.parallelize<std::vector<int>>(processFrames, frameIndices, [&]() {
+      return new BatchFrameArg(frames, idleProcessors, &_processorsMutex, frameResults);
+   });
+
+   BatchResults results;
+   for (const auto& frameResult : frameResults) {
+      results.frames.insert(results.frames.end(), frameResult.frames.begin(), frameResult.frames.end());
+      results.cards.insert(results.cards.end(), frameResult.cards.begin(), frameResult.cards.end());
+      results.sets.insert(results.sets.end(), frameResult.sets.begin(), frameResult.sets.end());
+   }
+
+   return results;
+}
+
+void
+BatchFrameProcessor::processFrames(
+   void* arg)
+{
+   BatchFrameArg* batchArg = (BatchFrameArg*)arg;
+
+   pthread_mutex_lock(batchArg->processorsMutex);
+   FrameProcessor* frameProcessor = batchArg->idleProcessors.back();
+   batchArg->idleProcessors.pop_back();
+   pthread_mutex_unlock(batchArg->processorsMutex);
+
+   for (auto it = batchArg->start; it != batchArg->end; it++) {
+      // Which frames a processor saw before depends on scheduling, so each frame starts fresh
+      frameProcessor->ResetStream();
+
+      auto start = std::chrono::steady_clock::now();
+      frameProcessor->Process(batchArg->frames[*it]);
+      std::chrono::duration<double, std::milli> processMillis = std::chrono::steady_clock::now() - start;
+      appendResults(*frameProcessor, *it, processMillis.count(), batchArg->frameResults[*it]);
+   }
+
+   pthread_mutex_lock(batchArg->processorsMutex);
+   batchArg->idleProcessors.push_back(frameProcessor);
+   pthread_mutex_unlock(batchArg->processorsMutex);
+}
+
+void
+BatchFrameProcessor::appendResults(
+   const FrameProcessor& frameProcessor,
+   const uint32_t frameIndex,
+   const double processMillis,
+   BatchResults& results)
+{
+   const std::vector<SetGame::Card>& cards = frameProcessor.GetCardsInFrame();
+   const std::vector<SetGame::Set>& sets = frameProcessor.GetSetsInFrame();
+
+   BatchFrameRecord frameRecord {};
+   frameRecord.frameIndex = frameIndex;
+   frameRecord.numCards = cards.size();
+   frameRecord.numSets = sets.size();
+   frameRecord.partial = frameProcessor.GetFrameIsPartial();
+   frameRecord.processMillis = processMillis;
+   results.frames.push_back(frameRecord);
+
+   for (const auto& card : cards) {
+      BatchCardRecord cardRecord {};
+      cardRecord.frameIndex = frameIndex;
+      cardRecord.contourIndex = card.contourIndex;
+      cardRecord.code = SetGame::encodeCard(card);
+      cardRecord.count = card.count;
+      cardRecord.color = static_cast<uint8_t>(card.shape.color);
+      cardRecord.symbol = static_cast<uint8_t>(card.shape.symbol);
+      cardRecord.shading = static_cast<uint8_t>(card.shape.shading);
+      results.cards.push_back(cardRecord);
+   }
+
+   for (const auto& set : sets) {
+      BatchSetRecord setRecord {};
+      setRecord.frameIndex = frameIndex;
+      for (int i = 0; i < 3; i++) {
+         setRecord.contourIndices[i] = set.cards[i].contourIndex;
+         setRecord.codes[i] = SetGame::encodeCard(set.cards[i]);
+      }
+      results.sets.push_back(setRecord);
+   }
+}
@@ -0,0 +1,82 @@
+//
+//  BatchSolver.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#include "BatchSolver.h"
+
+namespace SetGame {
+
+std::vector<int>
+BatchSolver::countSets(
+   std::vector<Board>& boards)
+{
+   std::vector<int> counts(boards.size());
+   _threadPool.parallelize<std::vector<Board>>(solveBoards, boards,
+      [&]() -> SolveBoardsArg* {
+         return new SolveBoardsArg(boards.begin(), &counts, nullptr);
+      }
+   );
+
+   return counts;
+}
+
+std::vector<std::vector<BoardSet>>
+BatchSolver::enumerateSets(
+   std::vector<Board>& boards)
+{
+   std::vector<std::vector<BoardSet>> sets(boards.size());
+   _threadPool.parallelize<std::vector<Board>>(solveBoards, boards,
+      [&]() -> SolveBoardsArg* {
+         return new SolveBoardsArg(boards.begin(), nullptr, &sets);
+      }
+   );
+
+   return sets;
+}
+
+int
+BatchSolver::countSets(
+   const Board& board)
+{
+   return StandardSetEngine::countSets(board.codes.data(), board.size);
+}
+
+void
+BatchSolver::enumerateSets(
+   const Board& board,
+   std::vector<BoardSet>& sets)
+{
+   StandardSetEngine::forEachSet(board.codes.data(), board.size,
+      [&](const std::array<int, 3>& positions) {
+         sets.push_back({ { (uint8_t)positions[0], (uint8_t)positions[1], (uint8_t)positions[2] } });
+      }
+   );
+}
+
+CardCode
+BatchSolver::thirdCard(
+   const CardCode c0,
+   const CardCode c1)
+{
+   return StandardSetEngine::thirdCard(c0, c1);
+}
+
+void
+BatchSolver::solveBoards(
+   void* voidArg)
+{
+   SolveBoardsArg* arg = (SolveBoardsArg*)voidArg;
+   for (auto it = arg->start; it != arg->end; it++) {
+      const int boardIndex = it - arg->first;
+      if (arg->counts) {
+         (*arg->counts)[boardIndex] = countSets(*it);
+      } else {
+         enumerateSets(*it, (*arg->sets)[boardIndex]);
+      }
+   }
+}
+
+} // namespace SetGame
@@ -0,0 +1,236 @@
+//
+//  ChangeEvents.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#include "ChangeEvents.h"
+
+/**
+ * A card in a new frame is the same card as one seen before if its center
+ * is within this fraction of the card's size of where that card was last
+ * seen.
+ */
+const float MATCH_DISTANCE_FRACTION = 0.5;
+
+void
+ChangeEventTracker::update(
+   const std::vector<CardObservation>& observations,
+   std::vector<ChangeEvent>& events)
+{
+   events.clear();
+   _cardEvents.clear();
+   matchObservations(observations);
+
+   // Follow the cards that were seen again and count frames for the ones that weren't
+   int numKept = 0;
+   for (int t = 0; t < _tracks.size(); t++) {
+      Track& track = _tracks[t];
+      const int observationIndex = _trackObservation[t];
+      if (observationIndex >= 0) {
+         observe(track, observations[observationIndex], _cardEvents);
+      } else {
+         track.missedFrames++;
+         track.pendingFrames = 0;
+
+         // Cards that were never reported leave as quietly as they came
+         if (!track.reported) continue;
+         if (track.missedFrames >= _debounceFrames) {
+            _cardEvents.push_back(cardEvent(ChangeEventType::CARD_DISAPPEARED, track));
+            continue;
+         }
+      }
+      _tracks[numKept++] = track;
+   }
+   _tracks.resize(numKept);
+
+   // Every card that didn't match one seen before is a new card
+   for (int o = 0; o < observations.size(); o++) {
+      if (_observationMatched[o]) continue;
+
+      Track track {};
+      track.id = _nextId++;
+      track.pendingCode = observations[o].code;
+      observe(track, observations[o], _cardEvents);
+      _tracks.push_back(track);
+   }
+
+   findSets(_newSets);
+   auto setLess = [](const SetIds& s0, const SetIds& s1) { return s0 < s1; };
+   for (const SetIds& set : _sets) {
+      if (!std::binary_search(_newSets.begin(), _newSets.end(), set, setLess)) {
+         events.push_back(setEvent(ChangeEventType::SET_LOST, set));
+      }
+   }
+   events.insert(events.end(), _cardEvents.begin(), _cardEvents.end());
+   for (const SetIds& set : _newSets) {
+      if (!std::binary_search(_sets.begin(), _sets.end(), set, setLess)) {
+         events.push_back(setEvent(ChangeEventType::SET_FOUND, set));
+      }
+   }
+   _sets.swap(_newSets);
+
+   _frameNumber++;
+}
+
+void
+ChangeEventTracker::snapshot(
+   std::vector<ChangeEvent>& events) const
+{
+   events.clear();
+   for (const Track& track : _tracks) {
+      if (track.reported) {
+         events.push_back(cardEvent(ChangeEventType::CARD_APPEARED, track));
+      }
+   }
+   for (const SetIds& set : _sets) {
+      events.push_back(setEvent(ChangeEventType::SET_FOUND, set));
+   }
+}
+
+void
+ChangeEventTracker::reset()
+{
+   _tracks.clear();
+   _sets.clear();
+}
+
+/**
+ * Pair observations with tracked cards, closest pairs first, so two cards
+ * that are near each other can't both claim the same one.
+ */
+void
+ChangeEventTracker::matchObservations(
+   const std::vector<CardObservation>& observations)
+{
+   _trackObservation.assign(_tracks.size(), -1);
+   _observationMatched.assign(observations.size(), false);
+
+   _candidates.clear();
+   for (int t = 0; t < _tracks.size(); t++) {
+      const Track& track = _tracks[t];
+      for (int o = 0; o < observations.size(); o++) {
+         const CardObservation& observation = observations[o];
+         const float dx = observation.x - track.x;
+         const float dy = observation.y - track.y;
+         const float maxDistance = MATCH_DISTANCE_FRACTION * std::max(observation.size, track.size);
+         const float distanceSquared = dx * dx + dy * dy;
+         if (distanceSquared < maxDistance * maxDistance) {
+            _candidates.emplace_back(distanceSquared, t, o);
+         }
+      }
+   }
+   std::sort(_candidates.begin(), _candidates.end());
+
+   for (const auto& [distanceSquared, t, o] : _candidates) {
+      if (_trackObservation[t] >= 0 || _observationMatched[o]) continue;
+      _trackObservation[t] = o;
+      _observationMatched[o] = true;
+   }
+}
+
+/**
+ * Move the track to where the card was seen and report the card once it
+ * has shown the same new code for the whole debounce window.
+ */
+void
+ChangeEventTracker::observe(
+   Track& track,
+   const CardObservation& observation,
+   std::vector<ChangeEvent>& cardEvents) const
+{
+   track.x = observation.x;
+   track.y = observation.y;
+   track.size = observation.size;
+   track.missedFrames = 0;
+
+   if (track.reported && observation.code == track.code) {
+      track.pendingFrames = 0;
+      return;
+   }
+
+   if (observation.code == track.pendingCode) {
+      track.pendingFrames++;
+   } else {
+      track.pendingCode = observation.code;
+      track.pendingFrames = 1;
+   }
+   if (track.pendingFrames < _debounceFrames) return;
+
+   ChangeEvent event;
+   if (track.reported) {
+      event = cardEvent(ChangeEventType::CARD_RECLASSIFIED, track);
+      event.previousCode = track.code;
+   } else {
+      event = cardEvent(ChangeEventType::CARD_APPEARED, track);
+      track.reported = true;
+   }
+   track.code = track.pendingCode;
+   track.pendingFrames = 0;
+   event.code = track.code;
+   cardEvents.push_back(event);
+}
+
+/**
+ * Sets among the reported cards.  With the cards sorted by code, then id,
+ * each set is found once, from the pair of its first two cards: the third
+ * card's code is a table lookup and it has to come after the pair.
+ */
+void
+ChangeEventTracker::findSets(
+   std::vector<SetIds>& sets)
+{
+   _reported.clear();
+   for (const Track& track : _tracks) {
+      if (track.reported) {
+         _reported.emplace_back(track.code, track.id);
+      }
+   }
+   std::sort(_reported.begin(), _reported.end());
+
+   sets.clear();
+   for (int i = 0; i < _reported.size(); i++) {
+      for (int j = i + 1; j < _reported.size(); j++) {
+         const SetGame::CardCode thirdCode =
+            SetGame::StandardSetEngine::thirdCard(_reported[i].first, _reported[j].first);
+         auto k = std::lower_bound(_reported.begin() + j + 1, _reported.end(),
+            std::make_pair(thirdCode, uint32_t(0)));
+         for (; k != _reported.end() && k->first == thirdCode; k++) {
+            SetIds set = { _reported[i].second, _reported[j].second, k->second };
+            std::sort(set.begin(), set.end());
+            sets.push_back(set);
+         }
+      }
+   }
+   std::sort(sets.begin(), sets.end());
+}
+
+ChangeEvent
+ChangeEventTracker::cardEvent(
+   const ChangeEventType type,
+   const Track& track) const
+{
+   ChangeEvent event {};
+   event.frameNumber = _frameNumber;
+   event.type = type;
+   event.code = track.code;
+   event.cardIds[0] = track.id;
+
+   return event;
+}
+
+ChangeEvent
+ChangeEventTracker::setEvent(
+   const ChangeEventType type,
+   const SetIds& set) const
+{
+   ChangeEvent event {};
+   event.frameNumber = _frameNumber;
+   event.type = type;
+   for (int i = 0; i < 3; i++) {
+      event.cardIds[i] = set[i];
+   }
+
+   return event;
+}
@@ -0,0 +1,183 @@
+//
+//  ClassificationCache.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#include "ClassificationCache.h"
+
+// Keep the top 3 bits of each channel
+const int SIGNATURE_QUANTIZATION_SHIFT = 5;
+
+// 64-bit FNV-1a constants
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+/**
+ * A card is in the same place as last frame if every corner of its quad
+ * moved at most this many pixels and the mean color inside the quad's
+ * bounding box changed by at most this much (summed over channels), which
+ * catches a card being swapped for another in the same spot.
+ */
+const int PLACEMENT_CORNER_TOLERANCE = 3;
+const double PLACEMENT_MEAN_TOLERANCE = 12;
+
+std::optional<SetGame::Card>
+ClassificationCache::lookupPlacement(
+   const CardPlacement& placement,
+   const int contourIndex)
+{
+   // Only cards seen last frame can still be in the same place
+   for (auto it = _entries.begin(); it != _entries.end(); it++) {
+      if (it->seenFrame != _frameNumber - 1 || expired(*it)) continue;
+      if (!samePlacement(it->placement, placement)) continue;
+
+      _placementHits++;
+      return hit(it, placement, contourIndex);
+   }
+
+   return std::nullopt;
+}
+
+std::optional<SetGame::Card>
+ClassificationCache::lookup(
+   const CardSignature& signature,
+   const CardPlacement& placement,
+   const int contourIndex)
+{
+   auto it = _index.find(signature.hash);
+   if (it == _index.end() || it->second->signature.values != signature.values) {
+      _misses++;
+      return std::nullopt;
+   }
+   if (expired(*it->second)) {
+      _entries.erase(it->second);
+      _index.erase(it);
+      _misses++;
+      return std::nullopt;
+   }
+
+   return hit(it->second, placement, contourIndex);
+}
+
+void
+ClassificationCache::insert(
+   const CardSignature& signature,
+   const CardPlacement& placement,
+   const SetGame::Card& card)
+{
+   auto it = _index.find(signature.hash);
+   if (it != _index.end()) {
+      _entries.erase(it->second);
+      _index.erase(it);
+   }
+
+   _entries.push_front({ signature, placement, card.shape, card.count, _frameNumber, _frameNumber });
+   _index[signature.hash] = _entries.begin();
+
+   if (_entries.size() > _capacity) {
+      _index.erase(_entries.back().signature.hash);
+      _entries.pop_back();
+   }
+}
+
+void
+ClassificationCache::clear()
+{
+   _entries.clear();
+   _index.clear();
+   _hits = 0;
+   _placementHits = 0;
+   _misses = 0;
+}
+
+bool
+ClassificationCache::expired(
+   const Entry& entry) const
+{
+   return _frameNumber - entry.insertedFrame >= _maxAgeFrames;
+}
+
+// Move the entry to the front of the LRU list and remember where the card is now
+SetGame::Card
+ClassificationCache::hit(
+   std::list<Entry>::iterator it,
+   const CardPlacement& placement,
+   const int contourIndex)
+{
+   _entries.splice(_entries.begin(), _entries, it);
+   it->placement = placement;
+   it->seenFrame = _frameNumber;
+   _hits++;
+
+   return SetGame::Card(it->shape, it->count, contourIndex);
+}
+
+bool
+ClassificationCache::samePlacement(
+   const CardPlacement& placement1,
+   const CardPlacement& placement2)
+{
+   if (placement1.quad.size() != placement2.quad.size()) return false;
+
+   for (int i = 0; i < placement1.quad.size(); i++) {
+      if (std::abs(placement1.quad[i].x - placement2.quad[i].x) > PLACEMENT_CORNER_TOLERANCE ||
+          std::abs(placement1.quad[i].y - placement2.quad[i].y) > PLACEMENT_CORNER_TOLERANCE) {
+         return false;
+      }
+   }
+
+   double meanDifference = 0;
+   for (int c = 0; c < 3; c++) {
+      meanDifference += std::abs(placement1.regionMean[c] - placement2.regionMean[c]);
+   }
+
+   return meanDifference <= PLACEMENT_MEAN_TOLERANCE;
+}
+
+double
+ClassificationCache::GetHitRate() const
+{
+   const int lookups = _hits + _misses;
+   if (lookups == 0) return 0;
+
+   return (double)_hits / lookups;
+}
+
+CardSignature
+ClassificationCache::computeSignature(
+   const cv::Mat& cardPatch)
+{
+   cv::Mat small;
+   cv::resize(cardPatch, small, cv::Size(SIGNATURE_WIDTH, SIGNATURE_HEIGHT), 0, 0, cv::INTER_AREA);
+
+   CardSignature signature;
+   signature.hash = FNV_OFFSET_BASIS;
+   int i = 0;
+   for (int y = 0; y < SIGNATURE_HEIGHT; y++) {
+      const cv::Vec3b* row = small.ptr<cv::Vec3b>(y);
+      for (int x = 0; x < SIGNATURE_WIDTH; x++) {
+         for (int c = 0; c < 3; c++) {
+            const uint8_t value = row[x][c] >> SIGNATURE_QUANTIZATION_SHIFT;
+            signature.values[i++] = value;
+            signature.hash = (signature.hash ^ value) * FNV_PRIME;
+         }
+      }
+   }
+
+   return signature;
+}
+
+CardPlacement
+ClassificationCache::computePlacement(
+   const cv::Mat& frame,
+   const std::vector<cv::Point>& quad)
+{
+   const cv::Rect region = cv::boundingRect(quad) & cv::Rect(0, 0, frame.cols, frame.rows);
+
+   CardPlacement placement;
+   placement.quad = quad;
+   placement.regionMean = region.area() > 0 ? cv::mean(frame(region)) : cv::Scalar();
+   return placement;
+}
@@ -0,0 +1,170 @@
+//
+//  FrameIngest.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#include "FrameIngest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+const int BACKOFF_SPINS = 64;
+const int BACKOFF_YIELDS = 64;
+const std::chrono::microseconds BACKOFF_SLEEP(100);
+const std::chrono::microseconds STALE_FRAME_POLL(200);
+
+int64_t
+ingestClockNanos()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void
+RingBackoff::wait()
+{
+   if (_numWaits < BACKOFF_SPINS) {
+      // Nothing to do but wait for the other side to catch up
+   } else if (_numWaits < BACKOFF_SPINS + BACKOFF_YIELDS) {
+      std::this_thread::yield();
+   } else {
+      std::this_thread::sleep_for(BACKOFF_SLEEP);
+   }
+   _numWaits++;
+}
+
+FrameIngestDaemon::FrameIngestDaemon(
+   FrameProcessor& frameProcessor,
+   const std::string& frameRingName,
+   const std::string& resultRingName,
+   const uint32_t numSlots,
+   const uint64_t maxFrameBytes) :
+      _frameProcessor(frameProcessor),
+      _frameRing(frameRingName, numSlots, sizeof(IngestFrameHeader) + maxFrameBytes),
+      _resultRing(resultRingName, numSlots, sizeof(IngestResult)) {}
+
+void
+FrameIngestDaemon::run(
+   const std::atomic<bool>& stop)
+{
+   std::atomic<bool> stopWatcher(false);
+   std::thread watcher;
+   if (_cancelStaleFrames) {
+      watcher = std::thread([&]() {
+         /**
+          * The frame being processed keeps its slot, so more than one
+          * queued means a newer frame, and processNext skips straight to
+          * the newest.  Each frame is only cancelled once.
+          */
+         int cancelledFrame = -1;
+         while (!stopWatcher.load(std::memory_order_relaxed)) {
+            const int inFlightFrame = _inFlightFrame.load(std::memory_order_acquire);
+            if (inFlightFrame >= 0 && inFlightFrame != cancelledFrame && _frameRing.GetNumQueued() > 1) {
+               // Names the frame, so if it has finished since this does nothing to the next one
+               _frameProcessor.CancelFrame(inFlightFrame);
+               cancelledFrame = inFlightFrame;
+            }
+            std::this_thread::sleep_for(STALE_FRAME_POLL);
+         }
+      });
+   }
+
+   RingBackoff backoff;
+   while (!stop.load(std::memory_order_relaxed)) {
+      if (processNext()) {
+         backoff.reset();
+      } else {
+         backoff.wait();
+      }
+   }
+
+   if (watcher.joinable()) {
+      stopWatcher.store(true);
+      watcher.join();
+   }
+}
+
+bool
+FrameIngestDaemon::processNext()
+{
+   // Only the newest frame is worth processing, drop the ones queued before it
+   if (_cancelStaleFrames) {
+      uint64_t staleSize;
+      while (_frameRing.GetNumQueued() > 1 && _frameRing.tryAcquireRead(staleSize) != nullptr) {
+         _frameRing.releaseRead();
+         _stats.numSkippedFrames++;
+      }
+   }
+
+   uint64_t size;
+   uint8_t* slot = _frameRing.tryAcquireRead(size);
+   if (slot == nullptr) return false;
+
+   const IngestFrameHeader& frameHeader = *(const IngestFrameHeader*)slot;
+   const uint64_t pixelBytes = (uint64_t)frameHeader.rows * frameHeader.step;
+   if (size < sizeof(IngestFrameHeader) || frameHeader.rows <= 0 || frameHeader.cols <= 0 ||
+       frameHeader.type != CV_8UC3 || frameHeader.step < frameHeader.cols * 3 ||
+       sizeof(IngestFrameHeader) + pixelBytes > size) {
+      _stats.numInvalidFrames++;
+      _frameRing.releaseRead();
+      return true;
+   }
+
+   // Process the frame in the slot; the slot isn't released until we're done with it
+   cv::Mat frame(frameHeader.rows, frameHeader.cols, frameHeader.type,
+      slot + sizeof(IngestFrameHeader), frameHeader.step);
+   auto start = std::chrono::steady_clock::now();
+   _inFlightFrame.store(_frameProcessor.GetNextFrameNumber(), std::memory_order_release);
+   _frameProcessor.Process(frame);
+   _inFlightFrame.store(-1, std::memory_order_release);
+   std::chrono::duration<double, std::milli> processMillis = std::chrono::steady_clock::now() - start;
+
+   if (_frameProcessor.GetFrameWasCancelled()) {
+      _frameRing.releaseRead();
+      _stats.numCancelledFrames++;
+      return true;
+   }
+
+   publishResult(frameHeader, processMillis.count());
+   _frameRing.releaseRead();
+
+   _stats.numFrames++;
+   _stats.processMillis += processMillis.count();
+
+   return true;
+}
+
+void
+FrameIngestDaemon::publishResult(
+   const IngestFrameHeader& frameHeader,
+   const double processMillis)
+{
+   // Never stall the frame ring waiting on a reader
+   IngestResult* result = (IngestResult*)_resultRing.tryAcquireWrite();
+   if (result == nullptr) {
+      _stats.numDroppedResults++;
+      return;
+   }
+
+   std::vector<SetGame::CardCode> cards =
+      SessionReplay::encodeCards(_frameProcessor.GetCardsInFrame());
+   std::vector<RecordedSet> sets =
+      SessionReplay::encodeSets(_frameProcessor.GetSetsInFrame());
+
+   result->frameId = frameHeader.frameId;
+   result->captureNanos = frameHeader.captureNanos;
+   result->processMillis = processMillis;
+   result->partial = _frameProcessor.GetFrameIsPartial();
+   result->reserved = 0;
+   result->numCards = std::min<size_t>(cards.size(), MAX_RESULT_CARDS);
+   result->numSets = std::min<size_t>(sets.size(), MAX_RESULT_SETS);
+   std::memcpy(result->cards, cards.data(), result->numCards * sizeof(SetGame::CardCode));
+   std::memcpy(result->sets, sets.data(), result->numSets * sizeof(RecordedSet));
+   result->publishNanos = ingestClockNanos();
+
+   _resultRing.commitWrite(ingestResultSize(result->numSets));
+}
@@ -8,6 +8,12 @@
 #include "FrameProcessor.h"
 #include "SetGame.h"
 #include "HighlightColors.h"
+#include "SessionCapture.h"
+#include "SymbolClassifier.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <numeric>
 
 const float MIN_CARD_AREA_PERCENTAGE = 0.007;
 
@@ -26,6 +32,25 @@ const float MIN_CARD_AREA_PERCENTAGE = 0.007;
 const int BLOCK_SIZE = 93;
 const int C = 11;
 
+/**
+ * Frames with at least this many pixels are thresholded in horizontal bands
+ * across the thread pool.  Each band is thresholded together with
+ * blockSize / 2 rows of halo above and below it, which is every row its
+ * pixels' neighborhoods touch, so the stitched result is identical to
+ * thresholding the whole frame at once.
+ */
+const int BANDED_THRESHOLD_MIN_PIXELS = 2000000;
+
+/**
+ * The classification deadline is this fraction of the frame deadline, which
+ * leaves time for building cards, finding sets and highlighting them.
+ */
+const double DEADLINE_CLASSIFY_FRACTION = 0.8;
+
+// Shapes classified after the deadline are classified on a downscaled crop
+const float APPROXIMATE_SHAPE_SCALE = 0.5;
+
+const int NEXT_HIERARCHY_INDEX = 0;
 const int CHILD_HIERARCHY_INDEX = 2;
 const float CARD_APPROX_ACCURACY = 0.04;
 const float MIN_ASPECT_RATIO = 1.0;
@@ -43,95 +68,328 @@ const int GREEN_MAX = 180;
 const int PURPLE_MIN = 180;
 const int PURPLE_MAX = 340;
 
-const float SHAPE_MATCH_DIAMOND_THRESHOLD = 0.065;
-const float SOLIDITY_SQUIGGLE_PILL_THRESHOLD = 0.9;
+/**
+ * In per-card classification mode a shape agrees with its card's largest
+ * shape if its area is at least this fraction of the largest shape's area
+ * and a finer polygon approximation has the same number of vertices.
+ */
+const float SHAPE_AGREEMENT_AREA_RATIO = 0.8;
+const float SHAPE_AGREEMENT_APPROX_ACCURACY = 0.02;
 
 const float BORDER_CONTOUR_SCALAR = -0.2;
 const float FILL_CONTOUR_SCALAR = -0.4;
 const float OUTLINE_CONTOUR_EXTERIOR_SCALAR = 0.3;
 const float OUTLINE_CONTOUR_INTERIOR_SCALAR = 0.1;
 
+/**
+ * The band scalars were tuned on shapes the size they are in a full
+ * resolution frame.  On a card patch a shape is only about 25 pixels
+ * across, so the outline ring would start a pixel outside the outline and
+ * average in the ink.  Patch shapes stretch their bands so each is at
+ * least this many pixels wide and the ring starts at least this far out.
+ * The contrast thresholds compare mean colors, which warping a card to a
+ * patch doesn't change, so they're shared.
+ */
+const float PATCH_MIN_BAND_WIDTH = 2;
+
+/**
+ * SPARSE shape sampling reads pixels on this many rays from the shape's
+ * center through evenly spaced points of its outline.  On each ray it
+ * samples every band MASKED averages over at these fractions of the way
+ * across the band: the border band between BORDER_CONTOUR_SCALAR and the
+ * outline, the fill inside FILL_CONTOUR_SCALAR, and the ring between the
+ * two outline scalars.
+ */
+const int SPARSE_SAMPLE_RAYS = 24;
+const std::array<float, 3> SPARSE_SAMPLE_DEPTHS = { 0.25, 0.5, 0.75 };
+const int SPARSE_SAMPLES_PER_BAND = SPARSE_SAMPLE_RAYS * SPARSE_SAMPLE_DEPTHS.size();
+
+/**
+ * Most of an open shape's border band is card, so its color is the median
+ * of the most saturated fraction of the border samples.  The fill of a
+ * striped shape is a mix of stripes and card, so it's a trimmed mean that
+ * drops this fraction of samples from each end rather than a median.
+ */
+const float SPARSE_COLOR_SAMPLE_FRACTION = 0.25;
+const float SPARSE_FILL_TRIM_FRACTION = 0.1;
+
 const int OPEN_SHADING_CONTRAST_THRESHOLD = 25;
 const int STRIPED_SHADING_CONTRAST_THRESHOLD = 125;
 
+/**
+ * Size cards are warped to, portrait, for their classification cache
+ * signature and for RECTIFIED classification.
+ */
+const int CARD_PATCH_WIDTH = 96;
+const int CARD_PATCH_HEIGHT = 150;
+
+/**
+ * Card patch thresholding and shape filtering.  The block size covers about
+ * a shape's height.  The margin hides the card's edge and any background
+ * the quad took in.  Shape areas are fractions of the patch's area.
+ */
+const int PATCH_BLOCK_SIZE = 31;
+const float PATCH_MARGIN = 0.06;
+const float PATCH_MIN_SHAPE_AREA = 0.02;
+const float PATCH_MAX_SHAPE_AREA = 0.3;
+
 const float HIGHLIGHT_SCALE_FACTOR = 0.15;
+const int HIGHLIGHT_THICKNESS = 9;
+
+/**
+ * The rendered highlight overlay is reused as long as every card quad
+ * corner is within this many pixels of where it was when the overlay
+ * was rendered.
+ */
+const int HIGHLIGHT_CACHE_TOLERANCE = 6;
 
 void
 FrameProcessor::Process(cv::Mat& frame)
 {
+   TRACE_SPAN("FrameProcessor::Process");
+   _stageMillis.fill(0);
+   _cardsInFrame.clear();
+   _setsInFrame.clear();
+   _numSetsInFrame = 0;
+   _cardObservations.clear();
+   _framePartial = false;
+   _approximatedCards.clear();
+   if (_deadlineMillis > 0) {
+      std::chrono::duration<double, std::milli> classifyBudget(_deadlineMillis * DEADLINE_CLASSIFY_FRACTION);
+      _classifyDeadline = std::chrono::steady_clock::now() +
+         std::chrono::duration_cast<std::chrono::steady_clock::duration>(classifyBudget);
+   } else {
+      _classifyDeadline = std::chrono::steady_clock::time_point::max();
+   }
+
+   _frameCancelled = false;
+   {
+      // Queue the frame's work as its own group so it can be cancelled, newer frames first
+      std::lock_guard<std::mutex> lock(_frameTaskGroupMutex);
+      _frameTaskGroup = std::make_shared<tp::TaskGroup>(_frameNumber++);
+      _threadPool.SetTaskGroup(_frameTaskGroup);
+   }
+
+   _stageAllocations.fill({});
+   _peakScratchBytes = 0;
+   const bool trackAllocations = AllocationTracker::isEnabled();
+   if (trackAllocations) {
+      _stageAllocationStart = AllocationTracker::snapshot();
+      AllocationTracker::resetPeak();
+   }
+   const int64_t frameStartLiveBytes = _stageAllocationStart.liveBytes;
+
+   if (_sessionRecorder == nullptr) {
+      processFrame(frame);
+   } else {
+      // Record the frame as it came in, before highlights are drawn on it
+      cv::Mat originalFrame = frame.clone();
+      processFrame(frame);
+      if (!_frameTaskGroup->isCancelled()) _sessionRecorder->append(originalFrame, *this);
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(_frameTaskGroupMutex);
+      _frameCancelled = _frameTaskGroup->isCancelled();
+      _frameTaskGroup = nullptr;
+      _threadPool.SetTaskGroup(nullptr);
+   }
+   if (_frameCancelled) {
+      _cardsInFrame.clear();
+      _setsInFrame.clear();
+      _numSetsInFrame = 0;
+   }
+
+   // A cancelled frame didn't see the table, so it can't count towards cards disappearing
+   if (_emitChangeEvents && !_frameCancelled) {
+      _changeEventTracker.update(_cardObservations, _changeEvents);
+   } else {
+      _changeEvents.clear();
+   }
+
+   if (trackAllocations) {
+      _peakScratchBytes = AllocationTracker::GetPeakLiveBytes() - frameStartLiveBytes;
+   }
+}
+
+void
+FrameProcessor::SetEmitChangeEvents(
+   bool emit)
+{
+   if (!emit) {
+      _changeEventTracker.reset();
+      _changeEvents.clear();
+   }
+   _emitChangeEvents = emit;
+}
+
+void
+FrameProcessor::ResetStream()
+{
+   _initialized = false;
+   _classificationCache.clear();
+   _setSolver.reset();
+   _overlay = HighlightOverlay();
+   _changeEventTracker.reset();
+   _changeEvents.clear();
+}
+
+void
+FrameProcessor::CancelFrame(
+   int frameNumber)
+{
+   // A frame's task group is prioritized by its frame number
+   std::lock_guard<std::mutex> lock(_frameTaskGroupMutex);
+   if (_frameTaskGroup && _frameTaskGroup->GetPriority() == frameNumber) {
+      _threadPool.cancelGroup(_frameTaskGroup);
+   }
+}
+
+void
+FrameProcessor::processFrame(cv::Mat& frame)
+{
+   auto stageStart = std::chrono::steady_clock::now();
+
    /**
-    * If this is the first frame processed we need to set some member
-    * variables.
+    * If this is the first frame processed, or the frame size has changed,
+    * we need to set some member variables.
     */
-   if (!_initialized) {
+   if (!_initialized || frame.size() != _frameSize) {
       _maxCardArea = frame.size().width * frame.size().height * .2;
       _minCardArea = frame.size().width * frame.size().height * MIN_CARD_AREA_PERCENTAGE;
       _maxShapeArea = _minCardArea * .8;
       _minShapeArea = _minCardArea / 7;
+      _frameSize = frame.size();
       _initialized = true;
    }
 
-   cv::Mat grayScaleFrame;
-   cv::cvtColor(frame, grayScaleFrame, cv::COLOR_BGR2GRAY);
+   /**
+    * Faster profiles find contours on a downscaled frame.  The contours are
+    * scaled back to frame coordinates so classification still samples the
+    * full resolution frame.
+    */
+   cv::Mat detectionFrame = frame;
+   if (_detectionScale < 1.0) {
+      cv::resize(frame, detectionFrame, cv::Size(), _detectionScale, _detectionScale, cv::INTER_AREA);
+   }
+
    cv::Mat threshold;
-   cv::adaptiveThreshold(grayScaleFrame, threshold, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY,
-      BLOCK_SIZE, C);
+   Threshold(detectionFrame, threshold);
+   endStage(ProcessStage::PREPROCESS, stageStart);
+   if (_frameTaskGroup->isCancelled()) return;
+
    std::vector<Contour> contours;
    std::vector<cv::Vec4i> hierarchy;
-   cv::findContours(threshold, contours, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_NONE);
+   /**
+    * Only keep the end points of horizontal, vertical and diagonal runs.
+    * Every later stage treats contours as polygons (area, perimeter, moments,
+    * approxPolyDP, convexHull and the filled masks are all the same for
+    * the compressed polygon) so storing every boundary pixel is wasted
+    * memory and copying.
+    */
+   cv::findContours(threshold, contours, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
+   if (_detectionScale < 1.0) {
+      const float inverseScale = 1.0 / _detectionScale;
+      for (auto& contour : contours) {
+         for (auto& point : contour) {
+            point = cv::Point(std::round(point.x * inverseScale), std::round(point.y * inverseScale));
+         }
+      }
+   }
+   endStage(ProcessStage::CONTOURS, stageStart);
    if (contours.empty()) return;
 
-   // Create indexed contours
-   int contourIndex = 0;
-   std::vector<IndexedContour> indexedContours;
-   std::transform(contours.begin(), contours.end(), std::back_inserter(indexedContours),
-      [&](const Contour& contour) {
-         contourIndex++;
-         return IndexedContour { contourIndex - 1, contour };
+   /**
+    * Filter cards.  Filtering works on contour indices into contours, with
+    * membership kept in bitmaps sized to the contour count, so no contour's
+    * points are copied.
+    */
+   std::vector<int> cardIndices;
+   ContourBitmap isCard(contours.size(), false);
+   std::unordered_map<int, Contour> cardQuads;
+   for (int contourIndex = 0; contourIndex < contours.size(); contourIndex++) {
+      if (cardFilter(contourIndex, contours, hierarchy, isCard, cardQuads)) {
+         cardIndices.push_back(contourIndex);
+      }
+   }
+   if (cardIndices.empty()) return;
+
+   /**
+    * Look up each card in the classification cache.  Cards that hit are
+    * complete already, so only the shapes of the remaining cards need to be
+    * filtered and classified.  A card that hasn't moved is found by its
+    * placement, only cards that moved are warped to compute a signature.
+    */
+   std::vector<SetGame::Card> indexedCards;
+   std::vector<int> uncachedCardIndices;
+   ContourBitmap isUncachedCard(contours.size(), false);
+   std::unordered_map<int, std::tuple<CardSignature, CardPlacement>> cardSignatures;
+   std::unordered_map<int, cv::Mat> cardPatches;
+   const bool rectified = _classificationMode == ClassificationMode::RECTIFIED;
+   const bool cardLocal = _classificationMode == ClassificationMode::CARD_LOCAL;
+   if (_useClassificationCache) _classificationCache.beginFrame();
+   for (int cardIndex : cardIndices) {
+      if (!_useClassificationCache) {
+         uncachedCardIndices.push_back(cardIndex);
+         isUncachedCard[cardIndex] = true;
+         continue;
       }
-   );
 
-   // Filter cards
-   std::vector<IndexedContour> indexedCardContours;
-   std::unordered_set<int> cardIndices;
-   std::copy_if(indexedContours.begin(), indexedContours.end(), std::back_inserter(indexedCardContours),
-      [&](const IndexedContour& indexedContour) {
-         return cardFilter(indexedContour,
-                           contours,
-                           hierarchy,
-                           cardIndices);
+      CardPlacement placement = ClassificationCache::computePlacement(frame, cardQuads[cardIndex]);
+      std::optional<SetGame::Card> cachedCard = _classificationCache.lookupPlacement(placement, cardIndex);
+      if (cachedCard) {
+         indexedCards.push_back(*cachedCard);
+         continue;
       }
-   );
-   if (indexedCardContours.empty()) return;
 
-   // Filter shapes
-   std::vector<IndexedContour> indexedShapeContours;
-   std::copy_if(indexedContours.begin(), indexedContours.end(), std::back_inserter(indexedShapeContours),
-      [&](const IndexedContour& indexedContour) {
-         return shapeFilter(indexedContour,
-                            hierarchy,
-                            cardIndices);
+      cv::Mat cardPatch = rectifyCard(frame, cardQuads[cardIndex]);
+      CardSignature signature = ClassificationCache::computeSignature(cardPatch);
+      cachedCard = _classificationCache.lookup(signature, placement, cardIndex);
+      if (cachedCard) {
+         indexedCards.push_back(*cachedCard);
+      } else {
+         uncachedCardIndices.push_back(cardIndex);
+         isUncachedCard[cardIndex] = true;
+         cardSignatures[cardIndex] = { signature, placement };
+         // Rectified classification can reuse the patch
+         if (rectified) cardPatches[cardIndex] = cardPatch;
       }
-   );
-   if (indexedShapeContours.empty()) return;
+   }
+
+   /**
+    * Filter shapes.  Rectified and card-local classification find each
+    * card's shapes as part of classifying the card instead.
+    */
+   std::vector<int> shapeIndices;
+   if (!rectified && !cardLocal) {
+      for (int contourIndex = 0; contourIndex < contours.size(); contourIndex++) {
+         if (shapeFilter(contourIndex, contours, hierarchy, isUncachedCard)) {
+            shapeIndices.push_back(contourIndex);
+         }
+      }
+   }
+   endStage(ProcessStage::FILTER, stageStart);
+   const bool nothingToClassify = rectified || cardLocal ?
+      uncachedCardIndices.empty() :
+      shapeIndices.empty();
+   if (nothingToClassify && indexedCards.empty()) return;
 
    // Classify shapes
    std::unordered_map<int, std::vector<SetGame::Shape>> cardIndexToShapesMap;
-   pthread_mutex_t mapMutex;
-   pthread_mutex_init(&mapMutex, NULL);
-   _threadPool.parallelize<std::vector<IndexedContour>>(classifyShapes, indexedShapeContours,
-      [&]() -> ClassifyShapeArg* {
-         ClassifyShapeArg* arg = new ClassifyShapeArg(
-            hierarchy, frame, cardIndexToShapesMap, &mapMutex);
-
-         return arg;
-      }
-   );
-   pthread_mutex_destroy(&mapMutex);
-   if (cardIndexToShapesMap.empty()) return;
+   if (rectified) {
+      classifyRectifiedCards(uncachedCardIndices, frame, cardQuads, cardPatches, cardIndexToShapesMap);
+   } else if (cardLocal) {
+      classifyCardsLocally(uncachedCardIndices, frame, contours, hierarchy, cardIndexToShapesMap);
+   } else if (_classificationMode == ClassificationMode::PER_CARD) {
+      classifyRepresentativeShapes(shapeIndices, contours, hierarchy, frame, cardIndexToShapesMap);
+   } else {
+      classifyShapesInParallel(shapeIndices, contours, hierarchy, frame, cardIndexToShapesMap);
+   }
+   if (_frameTaskGroup->isCancelled()) return;
+   _framePartial = !_approximatedCards.empty();
+   if (cardIndexToShapesMap.empty() && indexedCards.empty()) return;
 
    // Verify shapes and construct cards
-   std::vector<SetGame::Card> indexedCards;
    for (const auto& entry : cardIndexToShapesMap) {
       int cardIndex = entry.first;
       const std::vector<SetGame::Shape>& shapes = entry.second;
@@ -156,26 +414,130 @@ FrameProcessor::Process(cv::Mat& frame)
       // TODO: check shape positions relative to card and compare to number of shapes
       SetGame::Card card(shapes[0], shapes.size(), cardIndex);
       indexedCards.push_back(card);
+
+      // Don't let a guess made to meet the deadline stand in for the card in later frames
+      if (_approximatedCards.count(cardIndex)) continue;
+
+      auto it = cardSignatures.find(cardIndex);
+      if (it != cardSignatures.end()) {
+         const auto& [signature, placement] = it->second;
+         _classificationCache.insert(signature, placement, card);
+      }
    }
+   endStage(ProcessStage::CLASSIFY, stageStart);
 
-   // Get sets
-   std::vector<SetGame::Set> sets = getSortedSets(indexedCards);
-   _numSetsInFrame = sets.size();
+   // Get sets, only looking up the ones involving cards that changed since the last frame
+   // Solve into the previous frame's buffer so the steady state doesn't allocate
+   if (_approximatedCards.empty()) {
+      _setSolver.update(indexedCards, _setScratch);
+   } else {
+      // Approximated cards could complete sets that aren't on the table, so leave them out
+      std::vector<SetGame::Card> exactCards;
+      std::copy_if(indexedCards.begin(), indexedCards.end(), std::back_inserter(exactCards),
+         [&](const SetGame::Card& card) {
+            return _approximatedCards.count(card.contourIndex) == 0;
+         }
+      );
+      _setSolver.update(exactCards, _setScratch);
+   }
+   _numSetsInFrame = _setScratch.size();
+   if (_emitChangeEvents) {
+      // Where each card was seen, so the change event tracker can follow it from frame to frame
+      for (const SetGame::Card& card : indexedCards) {
+         const Contour& quad = cardQuads.at(card.contourIndex);
+         float x = 0;
+         float y = 0;
+         for (const cv::Point& point : quad) {
+            x += point.x;
+            y += point.y;
+         }
+         _cardObservations.push_back({ SetGame::encodeCard(card), x / quad.size(), y / quad.size(),
+            (float)std::sqrt(cv::contourArea(quad)) });
+      }
+   }
+   endStage(ProcessStage::SETS, stageStart);
 
    if (_showSets) {
-      highlightSets(frame, sets, contours);
+      highlightSets(frame, _setScratch, contours, cardQuads);
    }
+   endStage(ProcessStage::HIGHLIGHT, stageStart);
+
+   _cardsInFrame.swap(indexedCards);
+   _setsInFrame.swap(_setScratch);
+}
+
+/**
+ * Record how long the stage that began at stageStart took, and what it
+ * allocated, and start measuring the next stage.
+ */
+void
+FrameProcessor::endStage(
+   const ProcessStage stage,
+   std::chrono::steady_clock::time_point& stageStart)
+{
+   auto now = std::chrono::steady_clock::now();
+   std::chrono::duration<double, std::milli> elapsed = now - stageStart;
+   _stageMillis[static_cast<int>(stage)] = elapsed.count();
+   TRACE_RECORD_SPAN(PROCESS_STAGE_TO_STRING[static_cast<int>(stage)].c_str(), stageStart, now);
+   stageStart = now;
+
+   if (AllocationTracker::isEnabled()) {
+      AllocationTracker::Snapshot snapshot = AllocationTracker::snapshot();
+      AllocationTracker::AllocationStats& stats = _stageAllocations[static_cast<int>(stage)];
+      stats.numAllocations = snapshot.totals.numAllocations - _stageAllocationStart.totals.numAllocations;
+      stats.bytesAllocated = snapshot.totals.bytesAllocated - _stageAllocationStart.totals.bytesAllocated;
+      _stageAllocationStart = snapshot;
+   }
+}
+
+void
+FrameProcessor::Threshold(
+   const cv::Mat& frame,
+   cv::Mat& threshold)
+{
+   const int blockSize = scaledBlockSize(_detectionScale);
+   const int numBands = _threadPool.GetActiveThreads();
+   if (frame.total() < BANDED_THRESHOLD_MIN_PIXELS || numBands < 2) {
+      cv::Mat grayScaleFrame;
+      cv::cvtColor(frame, grayScaleFrame, cv::COLOR_BGR2GRAY);
+      cv::adaptiveThreshold(grayScaleFrame, threshold, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY,
+         blockSize, C);
+      return;
+   }
+
+   threshold.create(frame.size(), CV_8U);
+   std::vector<RowBand> bands;
+   for (int i = 0; i < numBands; i++) {
+      bands.push_back({ frame.rows * i / numBands, frame.rows * (i + 1) / numBands });
+   }
+
+   _threadPool.parallelize<std::vector<RowBand>>(thresholdBands, bands,
+      [&]() -> ThresholdBandArg* {
+         return new ThresholdBandArg(frame, threshold, blockSize);
+      }
+   );
+}
+
+void
+FrameProcessor::SetProfile(
+   ProcessingProfile profile)
+{
+   const ProfileSettings& settings = PROFILE_SETTINGS[static_cast<int>(profile)];
+   _profile = profile;
+   _detectionScale = settings.detectionScale;
+   _classificationMode = settings.classificationMode;
+   _threadPool.SetActiveThreads(_threadPool.GetNumThreads() - settings.threadsHeldBack);
 }
 
 bool
 FrameProcessor::cardFilter(
-   const IndexedContour& indexedContour,
+   const int index,
    const std::vector<Contour>& contours,
    const std::vector<cv::Vec4i>& hierarchy,
-   std::unordered_set<int>& cardIndices) const
+   ContourBitmap& isCard,
+   std::unordered_map<int, Contour>& cardQuads) const
 {
-   int index = std::get<0>(indexedContour);
-   const Contour& contour = std::get<1>(indexedContour);
+   const Contour& contour = contours[index];
 
    const int childIndex = hierarchy[index][CHILD_HIERARCHY_INDEX];
    if (childIndex < 0) {
@@ -195,8 +557,7 @@ FrameProcessor::cardFilter(
     * compare the area of the current contour with its child--if it's close then this is an
     * exterior contour.
     */
-   auto it = cardIndices.find(childIndex);
-   if (it != cardIndices.end()) return false;
+   if (isCard[childIndex]) return false;
 
    const double childArea = cv::contourArea(contours[childIndex]);
    if (childArea / area > .5) return false;
@@ -212,33 +573,42 @@ FrameProcessor::cardFilter(
    float aspectRatio = ((float)std::max(rect.height, rect.width) / std::min(rect.height, rect.width));
    if (aspectRatio < MIN_ASPECT_RATIO || aspectRatio > MAX_ASPECT_RATIO) return false;
 
-   cardIndices.insert(index);
+   isCard[index] = true;
+   normalizeQuad(approx);
+   cardQuads[index] = approx;
    return true;
 }
 
 bool
 FrameProcessor::shapeFilter(
-   const IndexedContour& indexedContour,
+   const int index,
+   const std::vector<Contour>& contours,
    const std::vector<cv::Vec4i>& hierarchy,
-   const std::unordered_set<int>& cardIndices) const
+   const ContourBitmap& isCard) const
 {
-   int index = std::get<0>(indexedContour);
-   const Contour& contour = std::get<1>(indexedContour);
-
    int parentIndex = hierarchy[index][PARENT_HIERARCHY_INDEX];
-   if (cardIndices.find(parentIndex) == cardIndices.end()) {
+   if (parentIndex < 0 || !isCard[parentIndex]) {
       // Current contour is not contained within a card
       return false;
    }
 
+   return isShapeContour(contours[index], _minShapeArea, _maxShapeArea);
+}
+
+bool
+FrameProcessor::isShapeContour(
+   const Contour& contour,
+   const float minShapeArea,
+   const float maxShapeArea)
+{
    /**
     * Area check
-    * The _minShapeArea condition filters out small smudges / artifacts
-    * and the _maxShapeArea condition filters out the inner border of the
+    * The minShapeArea condition filters out small smudges / artifacts
+    * and the maxShapeArea condition filters out the inner border of the
     * cards
     */
    const double area = cv::contourArea(contour);
-   if (area < _minShapeArea || area > _maxShapeArea) return false;
+   if (area < minShapeArea || area > maxShapeArea) return false;
 
    // Approximate contour is rectangle check
    double peri = cv::arcLength(contour, true) * SHAPE_APPROX_ACCURACY;
@@ -249,101 +619,626 @@ FrameProcessor::shapeFilter(
    return true;
 }
 
-std::vector<SetGame::Set>
-FrameProcessor::getSortedSets(
-   const std::vector<SetGame::Card> indexedCards) const
-{
-   std::vector<SetGame::Set> sets;
-   for (int i = 0; i < indexedCards.size(); i++) {
-      const SetGame::Card& cardI = indexedCards[i];
-      for (int j = i + 1; j < indexedCards.size(); j++) {
-         const SetGame::Card& cardJ = indexedCards[j];
-         for (int k = j + 1; k < indexedCards.size(); k++) {
-            const SetGame::Card& cardK = indexedCards[k];
-            if (SetGame::Set::isSet(cardI, cardJ, cardK)) {
-               std::vector<SetGame::Card> cards = { cardI, cardJ, cardK };
-               SetGame::Set set(cards);
-               sets.push_back(set);
+void
+FrameProcessor::highlightSets(
+   cv::Mat& frame,
+   const std::vector<SetGame::Set>& sets,
+   const std::vector<Contour>& contours,
+   const std::unordered_map<int, Contour>& cardQuads)
+{
+   /**
+    * Rendering the highlights means rescaling every card that's in more
+    * than one set and stroking thick contours over the whole frame.  When
+    * the same sets are found on cards that haven't moved (the common case
+    * for a camera pointed at a table) reuse the overlay rendered for an
+    * earlier frame and just blend it on.
+    */
+   std::vector<std::array<Contour, 3>> setQuads;
+   for (const auto& set : sets) {
+      std::array<Contour, 3> quads;
+      for (int i = 0; i < 3; i++) {
+         quads[i] = cardQuads.at(set.cards[i].contourIndex);
+      }
+      setQuads.push_back(quads);
+   }
+
+   if (!overlayMatches(frame.size(), setQuads)) {
+      renderOverlay(frame.size(), sets, contours);
+      _overlay.frameSize = frame.size();
+      _overlay.setQuads.swap(setQuads);
+   }
+
+   blendOverlay(frame);
+}
+
+bool
+FrameProcessor::overlayMatches(
+   const cv::Size& frameSize,
+   const std::vector<std::array<Contour, 3>>& setQuads) const
+{
+   if (frameSize != _overlay.frameSize) return false;
+   if (setQuads.size() != _overlay.setQuads.size()) return false;
+
+   for (int i = 0; i < setQuads.size(); i++) {
+      for (int j = 0; j < 3; j++) {
+         const Contour& quad = setQuads[i][j];
+         const Contour& cachedQuad = _overlay.setQuads[i][j];
+         if (quad.size() != cachedQuad.size()) return false;
+
+         for (int k = 0; k < quad.size(); k++) {
+            if (std::abs(quad[k].x - cachedQuad[k].x) > HIGHLIGHT_CACHE_TOLERANCE ||
+                std::abs(quad[k].y - cachedQuad[k].y) > HIGHLIGHT_CACHE_TOLERANCE) {
+               return false;
             }
          }
       }
    }
 
-   std::sort(sets.begin(), sets.end());
-   return sets;
+   return true;
 }
 
 void
-FrameProcessor::highlightSets(
-   cv::Mat& frame,
+FrameProcessor::renderOverlay(
+   const cv::Size& frameSize,
    const std::vector<SetGame::Set>& sets,
-   const std::vector<Contour>& contours) const
+   const std::vector<Contour>& contours)
 {
-   std::unordered_set<int> highlightedCards;
-   int i = 0;
-   while (i < sets.size()) {
+   /**
+    * Collect the strokes for each card first so every card gets a single
+    * tile sized to fit all of its (possibly expanded) highlight contours.
+    */
+   std::vector<int> cardOrder;
+   std::unordered_map<int, std::vector<std::tuple<Contour, cv::Scalar>>> cardStrokes;
+   for (int i = 0; i < sets.size(); i++) {
       const SetGame::Set& set = sets[i];
       int colorIndex = i % SET_HIGHLIGHT_COLORS.size();
-      cv::Scalar color = SET_HIGHLIGHT_COLORS[colorIndex];
+      const cv::Scalar& color = SET_HIGHLIGHT_COLORS[colorIndex];
       for (const auto& card : set.cards) {
-         std::vector<Contour> cardContour = { contours[card.contourIndex] };
-         if (highlightedCards.find(card.contourIndex) != highlightedCards.end()) {
+         Contour cardContour = contours[card.contourIndex];
+         auto it = cardStrokes.find(card.contourIndex);
+         if (it != cardStrokes.end()) {
             // We've already highlighted this card--expand the contour
-            scaleContour(cardContour[0], HIGHLIGHT_SCALE_FACTOR);
+            scaleContour(cardContour, HIGHLIGHT_SCALE_FACTOR);
+         } else {
+            cardOrder.push_back(card.contourIndex);
+         }
+         cardStrokes[card.contourIndex].push_back({ cardContour, color });
+      }
+   }
+
+   const cv::Rect frameRect(0, 0, frameSize.width, frameSize.height);
+   const int padding = HIGHLIGHT_THICKNESS / 2 + 1;
+   _overlay.tiles.clear();
+   for (int cardIndex : cardOrder) {
+      std::vector<Contour> strokeContours;
+      for (const auto& stroke : cardStrokes[cardIndex]) {
+         strokeContours.push_back(std::get<0>(stroke));
+      }
+
+      cv::Rect roi = cv::boundingRect(strokeContours[0]);
+      for (const auto& strokeContour : strokeContours) {
+         roi |= cv::boundingRect(strokeContour);
+      }
+      roi = cv::Rect(roi.x - padding, roi.y - padding,
+                     roi.width + 2 * padding, roi.height + 2 * padding) & frameRect;
+      if (roi.empty()) continue;
+
+      OverlayTile tile;
+      tile.roi = roi;
+      tile.bgra = cv::Mat::zeros(roi.size(), CV_8UC4);
+      const std::vector<std::tuple<Contour, cv::Scalar>>& strokes = cardStrokes[cardIndex];
+      for (int i = 0; i < strokes.size(); i++) {
+         const cv::Scalar& color = std::get<1>(strokes[i]);
+         cv::drawContours(tile.bgra, strokeContours, i,
+            cv::Scalar(color[0], color[1], color[2], 255), HIGHLIGHT_THICKNESS,
+            cv::LINE_8, cv::noArray(), INT_MAX, -roi.tl());
+      }
+      _overlay.tiles.push_back(tile);
+   }
+}
+
+void
+FrameProcessor::blendOverlay(
+   cv::Mat& frame) const
+{
+   for (const auto& tile : _overlay.tiles) {
+      cv::Mat region = frame(tile.roi);
+      for (int y = 0; y < tile.roi.height; y++) {
+         const cv::Vec4b* src = tile.bgra.ptr<cv::Vec4b>(y);
+         cv::Vec3b* dst = region.ptr<cv::Vec3b>(y);
+         for (int x = 0; x < tile.roi.width; x++) {
+            const int alpha = src[x][3];
+            if (alpha == 0) continue;
+
+            for (int c = 0; c < 3; c++) {
+               dst[x][c] = (uchar)((src[x][c] * alpha + dst[x][c] * (255 - alpha)) / 255);
+            }
+         }
+      }
+   }
+}
+
+void
+FrameProcessor::classifyCardsLocally(
+   std::vector<int>& cardIndices,
+   const cv::Mat& frame,
+   const std::vector<Contour>& contours,
+   const std::vector<cv::Vec4i>& hierarchy,
+   std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapesMap)
+{
+   pthread_mutex_t mapMutex;
+   pthread_mutex_init(&mapMutex, NULL);
+   _threadPool.parallelize<std::vector<int>>(classifyLocalCards, cardIndices,
+      [&]() -> LocalCardArg* {
+         return new LocalCardArg(frame, contours, hierarchy, _minShapeArea, _maxShapeArea,
+            cardIndexToShapesMap, &mapMutex, _classifyDeadline, &_approximatedCards,
+            _shapeSamplingMode);
+      },
+      // Work grows with the card's area, which the crop and masks cover
+      [&](const int cardIndex) -> double {
+         return cv::contourArea(contours[cardIndex]);
+      }
+   );
+   pthread_mutex_destroy(&mapMutex);
+}
+
+void
+FrameProcessor::classifyShapesInParallel(
+   std::vector<int>& shapeIndices,
+   const std::vector<Contour>& contours,
+   const std::vector<cv::Vec4i>& hierarchy,
+   cv::Mat& frame,
+   std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapesMap)
+{
+   pthread_mutex_t mapMutex;
+   pthread_mutex_init(&mapMutex, NULL);
+   _threadPool.parallelize<std::vector<int>>(classifyShapes, shapeIndices,
+      [&]() -> ClassifyShapeArg* {
+         ClassifyShapeArg* arg = new ClassifyShapeArg(
+            contours, hierarchy, frame, cardIndexToShapesMap, &mapMutex, _classifyDeadline,
+            &_approximatedCards, _shapeSamplingMode);
+
+         return arg;
+      },
+      [&](const int shapeIndex) -> double {
+         /**
+          * Classification cost grows with the length of the shape's outline.
+          * Contours are compressed so use the perimeter, not the point count.
+          */
+         return cv::arcLength(contours[shapeIndex], true);
+      }
+   );
+   pthread_mutex_destroy(&mapMutex);
+}
+
+void
+FrameProcessor::classifyRectifiedCards(
+   std::vector<int>& cardIndices,
+   const cv::Mat& frame,
+   const std::unordered_map<int, Contour>& cardQuads,
+   const std::unordered_map<int, cv::Mat>& cardPatches,
+   std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapesMap)
+{
+   pthread_mutex_t mapMutex;
+   pthread_mutex_init(&mapMutex, NULL);
+   _threadPool.parallelize<std::vector<int>>(classifyCards, cardIndices,
+      [&]() -> ClassifyCardArg* {
+         return new ClassifyCardArg(frame, cardQuads, cardPatches, cardIndexToShapesMap, &mapMutex,
+            _shapeSamplingMode);
+      },
+      // Every card costs the same on a fixed-size patch
+      [](const int cardIndex) -> double {
+         return 1;
+      }
+   );
+   pthread_mutex_destroy(&mapMutex);
+}
+
+/**
+ * Every shape on a card is supposed to be identical, so fully classify only
+ * the largest shape on each card.  The remaining shapes are compared to it
+ * with cheap geometric checks (area and a finer polygon approximation's
+ * vertex count) and inherit its classification if they agree.  Shapes that
+ * don't agree are fully classified so the consistency check in Process can
+ * still reject the card.
+ */
+void
+FrameProcessor::classifyRepresentativeShapes(
+   const std::vector<int>& shapeIndices,
+   const std::vector<Contour>& contours,
+   const std::vector<cv::Vec4i>& hierarchy,
+   cv::Mat& frame,
+   std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapesMap)
+{
+   // Group shapes by card, tracking the position of each card's largest shape
+   std::unordered_map<int, std::vector<int>> cardIndexToShapePositions;
+   std::unordered_map<int, int> cardIndexToRepresentative;
+   std::vector<double> areas(shapeIndices.size());
+   for (int i = 0; i < shapeIndices.size(); i++) {
+      const int parentIndex = hierarchy[shapeIndices[i]][PARENT_HIERARCHY_INDEX];
+      areas[i] = cv::contourArea(contours[shapeIndices[i]]);
+      cardIndexToShapePositions[parentIndex].push_back(i);
+
+      auto it = cardIndexToRepresentative.find(parentIndex);
+      if (it == cardIndexToRepresentative.end() || areas[i] > areas[it->second]) {
+         cardIndexToRepresentative[parentIndex] = i;
+      }
+   }
+
+   std::vector<int> representativeShapeIndices;
+   for (const auto& entry : cardIndexToRepresentative) {
+      representativeShapeIndices.push_back(shapeIndices[entry.second]);
+   }
+   classifyShapesInParallel(representativeShapeIndices, contours, hierarchy, frame, cardIndexToShapesMap);
+   if (_frameTaskGroup->isCancelled()) return;
+
+   std::vector<int> fallbackShapeIndices;
+   for (const auto& entry : cardIndexToShapePositions) {
+      const int cardIndex = entry.first;
+      const int representative = cardIndexToRepresentative[cardIndex];
+      const SetGame::Shape representativeShape = cardIndexToShapesMap[cardIndex][0];
+      const Contour& representativeContour = contours[shapeIndices[representative]];
+      const int representativeVertices = approxVertexCount(representativeContour);
+
+      for (int position : entry.second) {
+         if (position == representative) continue;
+
+         const Contour& contour = contours[shapeIndices[position]];
+         const double areaRatio = areas[position] / areas[representative];
+         if (areaRatio >= SHAPE_AGREEMENT_AREA_RATIO &&
+             approxVertexCount(contour) == representativeVertices) {
+            cardIndexToShapesMap[cardIndex].push_back(representativeShape);
+         } else {
+            fallbackShapeIndices.push_back(shapeIndices[position]);
          }
-         cv::drawContours(frame, cardContour, 0, color, 9);
-         highlightedCards.insert(card.contourIndex);
       }
-      i++;
+   }
+
+   if (!fallbackShapeIndices.empty()) {
+      classifyShapesInParallel(fallbackShapeIndices, contours, hierarchy, frame, cardIndexToShapesMap);
    }
 }
 
+// Scale the threshold neighborhood with the frame, keeping it odd and at least 3
+int
+FrameProcessor::scaledBlockSize(
+   const float scale)
+{
+   const int blockSize = (int)std::round(BLOCK_SIZE * scale) | 1;
+   return std::max(3, blockSize);
+}
+
+void
+FrameProcessor::thresholdBands(
+   void* voidArg)
+{
+   ThresholdBandArg* arg = (ThresholdBandArg*)voidArg;
+   const int halo = arg->blockSize / 2;
+   std::for_each(arg->start, arg->end,
+      [&](const RowBand& band) {
+         const int start = std::get<0>(band);
+         const int end = std::get<1>(band);
+         const int haloStart = std::max(0, start - halo);
+         const int haloEnd = std::min(arg->frame.rows, end + halo);
+
+         cv::Mat grayScaleBand, thresholdBand;
+         cv::cvtColor(arg->frame.rowRange(haloStart, haloEnd), grayScaleBand, cv::COLOR_BGR2GRAY);
+         cv::adaptiveThreshold(grayScaleBand, thresholdBand, 255, cv::ADAPTIVE_THRESH_MEAN_C,
+            cv::THRESH_BINARY, arg->blockSize, C);
+
+         // Keep only the band's own rows
+         cv::Mat output = arg->threshold.rowRange(start, end);
+         thresholdBand.rowRange(start - haloStart, end - haloStart).copyTo(output);
+      }
+   );
+}
+
 void
 FrameProcessor::classifyShapes(
    void* voidArg)
 {
    ClassifyShapeArg* arg = (ClassifyShapeArg*)voidArg;
+
+   // Symbols only depend on the contours so classify the whole batch up front
+   std::vector<const Contour*> shapeContours;
+   std::transform(arg->start, arg->end, std::back_inserter(shapeContours),
+      [&](const int shapeIndex) {
+         return &arg->contours[shapeIndex];
+      }
+   );
+   std::vector<SetGame::Symbol> symbols;
+   SymbolClassifier::classifyContours(shapeContours, symbols);
+
+   int position = 0;
    std::for_each(arg->start, arg->end,
-      [&](const IndexedContour& indexedShape) {
-         classifyShape(indexedShape, arg->hierarchy, arg->frame,
-            arg->cardIndexToShapesMap, arg->mapMutex);
+      [&](const int shapeIndex) {
+         const SetGame::Symbol symbol = symbols[position++];
+         if (arg->isCancelled()) return;
+
+         if (std::chrono::steady_clock::now() < arg->deadline) {
+            classifyShape(shapeIndex, arg->contours[shapeIndex], symbol, arg->hierarchy, arg->frame,
+               arg->cardIndexToShapesMap, arg->mapMutex, arg->samplingMode);
+            return;
+         }
+
+         /**
+          * Past the deadline.  Every shape on a card should be identical so
+          * reuse a shape already classified for this card, otherwise fall
+          * back to a cheaper approximate classification.  Either way the
+          * card is only a guess now, so mark it.
+          */
+         const int parentIndex = arg->hierarchy[shapeIndex][PARENT_HIERARCHY_INDEX];
+         pthread_mutex_lock(arg->mapMutex);
+         arg->approximatedCards->insert(parentIndex);
+         std::vector<SetGame::Shape>& shapes = arg->cardIndexToShapesMap[parentIndex];
+         const bool reused = !shapes.empty();
+         if (reused) {
+            shapes.push_back(shapes[0]);
+         }
+         pthread_mutex_unlock(arg->mapMutex);
+
+         if (!reused) {
+            approximateShape(shapeIndex, arg->contours[shapeIndex], symbol, arg->hierarchy, arg->frame,
+               arg->cardIndexToShapesMap, arg->mapMutex, arg->samplingMode);
+         }
       }
    );
 }
 
+void
+FrameProcessor::classifyCards(
+   void* voidArg)
+{
+   ClassifyCardArg* arg = (ClassifyCardArg*)voidArg;
+   std::for_each(arg->start, arg->end,
+      [&](const int cardIndex) {
+         if (arg->isCancelled()) return;
+
+         TRACE_SPAN("FrameProcessor::classifyCard");
+         auto it = arg->cardPatches.find(cardIndex);
+         const cv::Mat cardPatch = it != arg->cardPatches.end() ?
+            it->second :
+            rectifyCard(arg->frame, arg->cardQuads.at(cardIndex));
+
+         std::vector<SetGame::Shape> shapes = classifyCardPatch(cardPatch, arg->samplingMode);
+         if (shapes.empty()) return;
+
+         pthread_mutex_lock(arg->mapMutex);
+         arg->cardIndexToShapesMap[cardIndex] = std::move(shapes);
+         pthread_mutex_unlock(arg->mapMutex);
+      }
+   );
+}
+
+/**
+ * Find, classify and sample every shape on one card without leaving the
+ * card: its shapes are its children in the contour tree, reached through
+ * the hierarchy's child and sibling links, and colors are sampled from the
+ * card's crop of the frame.  The crop covers every mask sampleShape draws,
+ * so the shapes match sampling the whole frame while the masks stay the
+ * size of a card.  Past the deadline shapes after the first reuse its
+ * classification.
+ */
+void
+FrameProcessor::classifyLocalCards(
+   void* voidArg)
+{
+   LocalCardArg* arg = (LocalCardArg*)voidArg;
+   std::for_each(arg->start, arg->end,
+      [&](const int cardIndex) {
+         if (arg->isCancelled()) return;
+
+         TRACE_SPAN("FrameProcessor::classifyLocalCard");
+         std::vector<const Contour*> shapeContours;
+         for (int child = arg->hierarchy[cardIndex][CHILD_HIERARCHY_INDEX]; child >= 0;
+              child = arg->hierarchy[child][NEXT_HIERARCHY_INDEX]) {
+            if (isShapeContour(arg->contours[child], arg->minShapeArea, arg->maxShapeArea)) {
+               shapeContours.push_back(&arg->contours[child]);
+            }
+         }
+         if (shapeContours.empty()) return;
+
+         cv::Rect sampleRoi;
+         for (const Contour* contour : shapeContours) {
+            // Leave room for the outline mask, which extends past the shape
+            cv::Rect roi = cv::boundingRect(*contour);
+            const int padX = (int)(roi.width * OUTLINE_CONTOUR_EXTERIOR_SCALAR) + 1;
+            const int padY = (int)(roi.height * OUTLINE_CONTOUR_EXTERIOR_SCALAR) + 1;
+            roi = cv::Rect(roi.x - padX, roi.y - padY, roi.width + 2 * padX, roi.height + 2 * padY);
+            sampleRoi = sampleRoi.area() == 0 ? roi : sampleRoi | roi;
+         }
+         sampleRoi &= cv::Rect(0, 0, arg->frame.cols, arg->frame.rows);
+         std::vector<SetGame::Symbol> symbols;
+         SymbolClassifier::classifyContours(shapeContours, symbols);
+
+         const cv::Mat crop = arg->frame(sampleRoi);
+         std::vector<SetGame::Shape> shapes;
+         bool approximated = false;
+         for (int i = 0; i < shapeContours.size(); i++) {
+            if (i > 0 && std::chrono::steady_clock::now() >= arg->deadline) {
+               approximated = true;
+               shapes.push_back(shapes[0]);
+               continue;
+            }
+
+            Contour cropContour;
+            std::transform(shapeContours[i]->begin(), shapeContours[i]->end(), std::back_inserter(cropContour),
+               [&](const cv::Point& point) {
+                  return point - sampleRoi.tl();
+               }
+            );
+            shapes.push_back(sampleShape(cropContour, symbols[i], crop, arg->samplingMode, 0));
+         }
+
+         pthread_mutex_lock(arg->mapMutex);
+         arg->cardIndexToShapesMap[cardIndex] = std::move(shapes);
+         if (approximated) arg->approximatedCards->insert(cardIndex);
+         pthread_mutex_unlock(arg->mapMutex);
+      }
+   );
+}
+
+/**
+ * Find and classify the shapes on a rectified card patch.  Shapes are
+ * darker than the card around them, so an inverted adaptive threshold makes
+ * them the foreground and their outer contours are the shapes' outlines
+ * whatever their shading.
+ */
+std::vector<SetGame::Shape>
+FrameProcessor::classifyCardPatch(
+   const cv::Mat& cardPatch,
+   const ShapeSamplingMode samplingMode)
+{
+   cv::Mat grayScalePatch, threshold;
+   cv::cvtColor(cardPatch, grayScalePatch, cv::COLOR_BGR2GRAY);
+   cv::adaptiveThreshold(grayScalePatch, threshold, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY_INV,
+      PATCH_BLOCK_SIZE, C);
+
+   const int margin = (int)(CARD_PATCH_WIDTH * PATCH_MARGIN);
+   const cv::Rect interior(margin, margin, CARD_PATCH_WIDTH - 2 * margin, CARD_PATCH_HEIGHT - 2 * margin);
+   cv::Mat interiorThreshold = cv::Mat::zeros(threshold.size(), CV_8U);
+   cv::Mat interiorRegion = interiorThreshold(interior);
+   threshold(interior).copyTo(interiorRegion);
+
+   std::vector<Contour> contours;
+   cv::findContours(interiorThreshold, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+   const double patchArea = CARD_PATCH_WIDTH * CARD_PATCH_HEIGHT;
+   std::vector<const Contour*> shapeContours;
+   for (const auto& contour : contours) {
+      const double area = cv::contourArea(contour);
+      if (area < patchArea * PATCH_MIN_SHAPE_AREA || area > patchArea * PATCH_MAX_SHAPE_AREA) continue;
+
+      shapeContours.push_back(&contour);
+   }
+
+   std::vector<SetGame::Symbol> symbols;
+   SymbolClassifier::classifyContours(shapeContours, symbols);
+
+   std::vector<SetGame::Shape> shapes;
+   for (int i = 0; i < shapeContours.size(); i++) {
+      shapes.push_back(sampleShape(*shapeContours[i], symbols[i], cardPatch, samplingMode,
+         PATCH_MIN_BAND_WIDTH));
+   }
+
+   return shapes;
+}
+
+/**
+ * Classify a shape on a downscaled crop around it instead of the full frame.
+ * The masks classifyShape draws are the size of the frame it's given, so
+ * this is much cheaper at the cost of sampling fewer pixels.
+ */
+void
+FrameProcessor::approximateShape(
+   const int contourIndex,
+   const Contour& contour,
+   const SetGame::Symbol symbol,
+   const std::vector<cv::Vec4i>& hierarchy,
+   const cv::Mat& frame,
+   std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapeMap,
+   pthread_mutex_t* mapMutex,
+   const ShapeSamplingMode samplingMode)
+{
+   // Leave room for the outline mask, which extends past the shape
+   cv::Rect roi = cv::boundingRect(contour);
+   const int padX = (int)(roi.width * OUTLINE_CONTOUR_EXTERIOR_SCALAR) + 1;
+   const int padY = (int)(roi.height * OUTLINE_CONTOUR_EXTERIOR_SCALAR) + 1;
+   roi = cv::Rect(roi.x - padX, roi.y - padY, roi.width + 2 * padX, roi.height + 2 * padY) &
+      cv::Rect(0, 0, frame.cols, frame.rows);
+
+   cv::Mat crop;
+   cv::resize(frame(roi), crop, cv::Size(), APPROXIMATE_SHAPE_SCALE, APPROXIMATE_SHAPE_SCALE, cv::INTER_AREA);
+
+   Contour cropContour;
+   std::transform(contour.begin(), contour.end(), std::back_inserter(cropContour),
+      [&](const cv::Point& point) {
+         return cv::Point((point.x - roi.x) * APPROXIMATE_SHAPE_SCALE,
+                          (point.y - roi.y) * APPROXIMATE_SHAPE_SCALE);
+      }
+   );
+
+   classifyShape(contourIndex, cropContour, symbol, hierarchy, crop,
+      cardIndexToShapeMap, mapMutex, samplingMode);
+}
+
 void
 FrameProcessor::classifyShape(
-   const IndexedContour& indexedShape,
+   const int contourIndex,
+   const Contour& contour,
+   const SetGame::Symbol symbol,
    const std::vector<cv::Vec4i>& hierarchy,
    const cv::Mat& frame,
    std::unordered_map<int, std::vector<SetGame::Shape>>& cardIndexToShapeMap,
-   pthread_mutex_t* mapMutex)
+   pthread_mutex_t* mapMutex,
+   const ShapeSamplingMode samplingMode)
 {
-   const int contourIndex = std::get<0>(indexedShape);
-   const Contour& contour = std::get<1>(indexedShape);
+   TRACE_SPAN("FrameProcessor::classifyShape");
+   SetGame::Shape shape = sampleShape(contour, symbol, frame, samplingMode, 0);
 
-   /**
-    * Detect contour's symbol by comparing the approximate, 4-sided contour to the actual contour.
-    * If it's within a certain similarity then it's a diamond because diamonds are the shape that can most
-    * accurately be approximated with only 4 sides.  If it's not a diamond then use the convex hull to distinguish
-    * between squiggles and ovals.
-    */
-   const double peri = cv::arcLength(contour, true) * SHAPE_APPROX_ACCURACY;
-   Contour approx;
-   cv::approxPolyDP(contour, approx, peri, true);
-   double shapeMatchRatio = cv::matchShapes(contour, approx, cv::CONTOURS_MATCH_I1, 0);
-   SetGame::Symbol symbol;
-   if (shapeMatchRatio < SHAPE_MATCH_DIAMOND_THRESHOLD) {
-      symbol = SetGame::Symbol::DIAMOND;
-   } else {
-      Contour hull;
-      cv::convexHull(contour, hull);
-      double solidityRatio = cv::contourArea(contour) / cv::contourArea(hull);
-      symbol = (solidityRatio < SOLIDITY_SQUIGGLE_PILL_THRESHOLD) ?
-         SetGame::Symbol::SQUIGGLE :
-         SetGame::Symbol::OVAL;
+   const int parentIndex = hierarchy[contourIndex][PARENT_HIERARCHY_INDEX];
+   pthread_mutex_lock(mapMutex);
+   cardIndexToShapeMap[parentIndex].push_back(shape);
+   pthread_mutex_unlock(mapMutex);
+}
+
+// Sample the shape's color and shading from the frame
+SetGame::Shape
+FrameProcessor::sampleShape(
+   const Contour& contour,
+   const SetGame::Symbol symbol,
+   const cv::Mat& frame,
+   const ShapeSamplingMode samplingMode,
+   const float minBandWidth)
+{
+   if (samplingMode == ShapeSamplingMode::SPARSE) {
+      return sampleShapeSparse(contour, symbol, frame, minBandWidth);
    }
 
+   return sampleShapeMasked(contour, symbol, frame, minBandWidth);
+}
+
+struct BandScalars {
+   float border;
+   float fill;
+   float outlineInterior;
+   float outlineExterior;
+};
+
+/**
+ * The band scalars for a shape, stretched so every band is at least
+ * minBandWidth pixels wide across the shape's narrower side.  A
+ * minBandWidth of 0 leaves them as tuned.
+ */
+static BandScalars
+bandScalars(
+   const Contour& contour,
+   const float minBandWidth)
+{
+   BandScalars bands = { BORDER_CONTOUR_SCALAR, FILL_CONTOUR_SCALAR,
+      OUTLINE_CONTOUR_INTERIOR_SCALAR, OUTLINE_CONTOUR_EXTERIOR_SCALAR };
+   if (minBandWidth <= 0) return bands;
+
+   // Scalars move points by a fraction of their distance from the center
+   const cv::Rect bounds = cv::boundingRect(contour);
+   const float minScalar = minBandWidth / std::max(std::min(bounds.width, bounds.height) / 2.0f, 1.0f);
+   bands.border = std::min(bands.border, -minScalar);
+   bands.fill = std::min(bands.fill, bands.border - minScalar);
+   bands.outlineInterior = std::max(bands.outlineInterior, minScalar);
+   bands.outlineExterior = std::max(bands.outlineExterior, bands.outlineInterior + minScalar);
+
+   return bands;
+}
+
+SetGame::Shape
+FrameProcessor::sampleShapeMasked(
+   const Contour& contour,
+   const SetGame::Symbol symbol,
+   const cv::Mat& frame,
+   const float minBandWidth)
+{
+   const BandScalars bands = bandScalars(contour, minBandWidth);
+
    // Detect contour's color
    cv::Moments M = cv::moments(contour);
    int cx = (int)(M.m10 / M.m00);
@@ -352,7 +1247,7 @@ FrameProcessor::classifyShape(
    Contour borderContour;
    std::transform(contour.begin(), contour.end(), std::back_inserter(borderContour),
       [&](const cv::Point& point) {
-         return scalePoint(point, cx, cy, BORDER_CONTOUR_SCALAR);
+         return scalePoint(point, cx, cy, bands.border);
       }
    );
    std::vector<Contour> border = { borderContour };
@@ -361,23 +1256,7 @@ FrameProcessor::classifyShape(
    std::vector<Contour> c = { contour };
    cv::drawContours(borderContourMask, c, 0, cv::Scalar(255), -1);
    cv::drawContours(borderContourMask, border, 0, cv::Scalar(0), -1);
-   cv::Scalar meanColor = cv::mean(frame, borderContourMask);
-
-   int blue = (int)meanColor[0];
-   int green = (int)meanColor[1];
-   int red = (int)meanColor[2];
-
-   std::tuple<int, int, int> hsv =
-      bgrToHsv(blue, green, red);
-   const int hue = std::get<0>(hsv);
-   SetGame::Color color;
-   if (hue > RED_MIN || hue <= RED_MAX) {
-      color = SetGame::Color::RED;
-   } else if (hue > GREEN_MIN && hue <= GREEN_MAX) {
-      color = SetGame::Color::GREEN;
-   } else {
-      color = SetGame::Color::PURPLE;
-   }
+   const SetGame::Color color = classifyColor(cv::mean(frame, borderContourMask));
 
    /**
     * Detect contour's shading by comparing the average color of the outline of the shape
@@ -387,17 +1266,17 @@ FrameProcessor::classifyShape(
    Contour fillContour, outlineContourExterior, outlineContourInterior;
    std::transform(contour.begin(), contour.end(), std::back_inserter(fillContour),
       [&](const cv::Point& point) {
-         return scalePoint(point, cx, cy, FILL_CONTOUR_SCALAR);
+         return scalePoint(point, cx, cy, bands.fill);
       }
    );
    std::transform(contour.begin(), contour.end(), std::back_inserter(outlineContourExterior),
       [&](const cv::Point& point) {
-         return scalePoint(point, cx, cy, OUTLINE_CONTOUR_EXTERIOR_SCALAR);
+         return scalePoint(point, cx, cy, bands.outlineExterior);
       }
    );
    std::transform(contour.begin(), contour.end(), std::back_inserter(outlineContourInterior),
       [&](const cv::Point& point) {
-         return scalePoint(point, cx, cy, OUTLINE_CONTOUR_INTERIOR_SCALAR);
+         return scalePoint(point, cx, cy, bands.outlineInterior);
       }
    );
 
@@ -413,21 +1292,173 @@ FrameProcessor::classifyShape(
    cv::drawContours(fillMask, fill, 0, cv::Scalar(255), -1);
    cv::Scalar meanFillColor = cv::mean(frame, fillMask);
 
-   const double colorDiff = colorDifference(meanBorderColor, meanFillColor);
-   SetGame::Shading shading;
+   return SetGame::Shape(color, symbol, classifyShading(meanBorderColor, meanFillColor));
+}
+
+/**
+ * Read the pixels SPARSE sampling uses from the band between the outline
+ * scaled by innerScalar and by outerScalar, one per ray and depth.
+ */
+static void
+sampleBand(
+   const cv::Mat& frame,
+   const cv::Point2f& center,
+   const std::array<cv::Point2f, SPARSE_SAMPLE_RAYS>& rayPoints,
+   const float innerScalar,
+   const float outerScalar,
+   std::array<cv::Vec3b, SPARSE_SAMPLES_PER_BAND>& samples)
+{
+   int i = 0;
+   for (const cv::Point2f& point : rayPoints) {
+      for (const float depth : SPARSE_SAMPLE_DEPTHS) {
+         // Same mapping as scalePoint, which moves points along the ray from the center
+         const float scalar = innerScalar + (outerScalar - innerScalar) * depth;
+         const int x = std::clamp((int)(point.x - (center.x - point.x) * scalar), 0, frame.cols - 1);
+         const int y = std::clamp((int)(point.y - (center.y - point.y) * scalar), 0, frame.rows - 1);
+         samples[i++] = frame.at<cv::Vec3b>(y, x);
+      }
+   }
+}
+
+/**
+ * Per channel mean of the samples in [first, last) after dropping trim of
+ * them from each end.  A trim of half the samples leaves the median.
+ */
+static cv::Scalar
+trimmedChannelMean(
+   const cv::Vec3b* first,
+   const cv::Vec3b* last,
+   const int trim)
+{
+   std::array<uchar, SPARSE_SAMPLES_PER_BAND> channel;
+   const int count = last - first;
+   const int kept = std::max(1, count - 2 * trim);
+   cv::Scalar mean;
+   for (int c = 0; c < 3; c++) {
+      std::transform(first, last, channel.begin(),
+         [&](const cv::Vec3b& sample) {
+            return sample[c];
+         }
+      );
+      std::sort(channel.begin(), channel.begin() + count);
+      const int start = std::min(trim, count - kept);
+      mean[c] = std::accumulate(channel.begin() + start, channel.begin() + start + kept, 0.0) / kept;
+   }
+
+   return mean;
+}
+
+/**
+ * Sample the shape's color and shading from a few pixels on rays from its
+ * center through evenly spaced points of its outline, at depths inside the
+ * bands sampleShapeMasked draws, instead of from masks.
+ */
+SetGame::Shape
+FrameProcessor::sampleShapeSparse(
+   const Contour& contour,
+   const SetGame::Symbol symbol,
+   const cv::Mat& frame,
+   const float minBandWidth)
+{
+   cv::Moments M = cv::moments(contour);
+   const cv::Point2f center(M.m10 / M.m00, M.m01 / M.m00);
+
+   // Space the rays evenly by arc length, compressed contours have uneven point spacing
+   std::array<cv::Point2f, SPARSE_SAMPLE_RAYS> rayPoints;
+   const double perimeter = cv::arcLength(contour, true);
+   double segmentStart = 0;
+   int segment = 0;
+   for (int i = 0; i < SPARSE_SAMPLE_RAYS; i++) {
+      const double target = perimeter * (i + 0.5) / SPARSE_SAMPLE_RAYS;
+      cv::Point2f from, to;
+      double segmentLength;
+      while (true) {
+         from = contour[segment];
+         to = contour[(segment + 1) % contour.size()];
+         segmentLength = cv::norm(to - from);
+         if (segmentStart + segmentLength >= target || segment == contour.size() - 1) break;
+         segmentStart += segmentLength;
+         segment++;
+      }
+      const float t = segmentLength > 0 ?
+         std::clamp((float)((target - segmentStart) / segmentLength), 0.0f, 1.0f) : 0.0f;
+      rayPoints[i] = from + (to - from) * t;
+   }
+
+   const BandScalars bands = bandScalars(contour, minBandWidth);
+   std::array<cv::Vec3b, SPARSE_SAMPLES_PER_BAND> borderSamples, fillSamples, outlineSamples;
+   sampleBand(frame, center, rayPoints, bands.border, 0, borderSamples);
+   sampleBand(frame, center, rayPoints, -1, bands.fill, fillSamples);
+   sampleBand(frame, center, rayPoints, bands.outlineInterior, bands.outlineExterior, outlineSamples);
+
+   // Color from the most saturated border samples, which fall on the shape's ink
+   const int numColorSamples = std::max(1, (int)(SPARSE_SAMPLES_PER_BAND * SPARSE_COLOR_SAMPLE_FRACTION));
+   const auto chroma = [](const cv::Vec3b& sample) {
+      return std::max({ sample[0], sample[1], sample[2] }) - std::min({ sample[0], sample[1], sample[2] });
+   };
+   std::nth_element(borderSamples.begin(), borderSamples.begin() + numColorSamples, borderSamples.end(),
+      [&](const cv::Vec3b& sample1, const cv::Vec3b& sample2) {
+         return chroma(sample1) > chroma(sample2);
+      }
+   );
+   const SetGame::Color color = classifyColor(trimmedChannelMean(borderSamples.data(),
+      borderSamples.data() + numColorSamples, (numColorSamples - 1) / 2));
+
+   const cv::Scalar outlineColor = trimmedChannelMean(outlineSamples.data(),
+      outlineSamples.data() + SPARSE_SAMPLES_PER_BAND, (SPARSE_SAMPLES_PER_BAND - 1) / 2);
+   const cv::Scalar fillColor = trimmedChannelMean(fillSamples.data(),
+      fillSamples.data() + SPARSE_SAMPLES_PER_BAND, (int)(SPARSE_SAMPLES_PER_BAND * SPARSE_FILL_TRIM_FRACTION));
+
+   return SetGame::Shape(color, symbol, classifyShading(outlineColor, fillColor));
+}
+
+SetGame::Color
+FrameProcessor::classifyColor(
+   const cv::Scalar& borderColor)
+{
+   int blue = (int)borderColor[0];
+   int green = (int)borderColor[1];
+   int red = (int)borderColor[2];
+
+   std::tuple<int, int, int> hsv =
+      bgrToHsv(blue, green, red);
+   const int hue = std::get<0>(hsv);
+   if (hue > RED_MIN || hue <= RED_MAX) {
+      return SetGame::Color::RED;
+   } else if (hue > GREEN_MIN && hue <= GREEN_MAX) {
+      return SetGame::Color::GREEN;
+   }
+
+   return SetGame::Color::PURPLE;
+}
+
+/**
+ * Shading is decided by the contrast between the color just outside the
+ * shape's outline and the color of its fill.
+ */
+SetGame::Shading
+FrameProcessor::classifyShading(
+   const cv::Scalar& outlineColor,
+   const cv::Scalar& fillColor)
+{
+   const double colorDiff = colorDifference(outlineColor, fillColor);
    if (colorDiff < OPEN_SHADING_CONTRAST_THRESHOLD) {
-      shading = SetGame::Shading::OPEN;
+      return SetGame::Shading::OPEN;
    } else if (colorDiff < STRIPED_SHADING_CONTRAST_THRESHOLD) {
-      shading = SetGame::Shading::STRIPED;
-   } else {
-      shading = SetGame::Shading::SOLID;
+      return SetGame::Shading::STRIPED;
    }
 
-   SetGame::Shape shape(color, symbol, shading);
-   const int parentIndex = hierarchy[contourIndex][PARENT_HIERARCHY_INDEX];
-   pthread_mutex_lock(mapMutex);
-   cardIndexToShapeMap[parentIndex].push_back(shape);
-   pthread_mutex_unlock(mapMutex);
+   return SetGame::Shading::SOLID;
+}
+
+int
+FrameProcessor::approxVertexCount(
+   const Contour& contour)
+{
+   const double peri = cv::arcLength(contour, true) * SHAPE_AGREEMENT_APPROX_ACCURACY;
+   Contour approx;
+   cv::approxPolyDP(contour, approx, peri, true);
+   return approx.size();
 }
 
 void
@@ -446,6 +1477,49 @@ FrameProcessor::scaleContour(
    );
 }
 
+/**
+ * Warp a card quad to a small upright patch.  The quad's shorter side is
+ * mapped to the patch's width so portrait and landscape cards produce the
+ * same patch.
+ */
+cv::Mat
+FrameProcessor::rectifyCard(
+   const cv::Mat& frame,
+   const Contour& quad)
+{
+   std::vector<cv::Point2f> src(quad.begin(), quad.end());
+   const float w = CARD_PATCH_WIDTH;
+   const float h = CARD_PATCH_HEIGHT;
+   std::vector<cv::Point2f> dst;
+   if (cv::norm(quad[1] - quad[0]) <= cv::norm(quad[2] - quad[1])) {
+      dst = { { 0, 0 }, { w, 0 }, { w, h }, { 0, h } };
+   } else {
+      dst = { { 0, 0 }, { 0, h }, { w, h }, { w, 0 } };
+   }
+
+   cv::Mat transform = cv::getPerspectiveTransform(src, dst);
+   cv::Mat patch;
+   cv::warpPerspective(frame, patch, transform, cv::Size(CARD_PATCH_WIDTH, CARD_PATCH_HEIGHT));
+   return patch;
+}
+
+/**
+ * approxPolyDP can start a quad at any of its corners.  Rotate the quad so
+ * it starts at the top-left-most corner, letting quads of the same card
+ * from different frames be compared corner by corner.
+ */
+void
+FrameProcessor::normalizeQuad(
+   Contour& quad)
+{
+   auto first = std::min_element(quad.begin(), quad.end(),
+      [](const cv::Point& p1, const cv::Point& p2) {
+         return p1.x + p1.y < p2.x + p2.y;
+      }
+   );
+   std::rotate(quad.begin(), first, quad.end());
+}
+
 cv::Point
 FrameProcessor::scalePoint(
    const cv::Point& point,
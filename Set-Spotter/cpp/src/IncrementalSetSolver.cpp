@@ -0,0 +1,177 @@
+//
+//  IncrementalSetSolver.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#include "IncrementalSetSolver.h"
+#include "BatchSolver.h"
+
+namespace SetGame {
+
+/**
+ * Look up every triple again once more than this fraction of the present
+ * codes changed.  Both cost about (changed codes) x (present codes) lookups
+ * but a full recompute doesn't have to filter the old triples.
+ */
+const float MAX_INCREMENTAL_CHANGE_FRACTION = 0.5;
+
+void
+IncrementalSetSolver::update(
+   const std::vector<Card>& cards,
+   std::vector<Set>& sets)
+{
+   std::array<int, NUM_CARD_CODES> counts = {};
+   for (const auto& card : cards) {
+      counts[encodeCard(card)]++;
+   }
+
+   // Bucket the cards' positions by code (a counting sort) so each code's cards are contiguous
+   std::array<int, NUM_CARD_CODES + 1> starts = {};
+   for (int code = 0; code < NUM_CARD_CODES; code++) {
+      starts[code + 1] = starts[code] + counts[code];
+   }
+   std::array<int, NUM_CARD_CODES> next = {};
+   std::copy(starts.begin(), starts.end() - 1, next.begin());
+   _positions.resize(cards.size());
+   for (int i = 0; i < cards.size(); i++) {
+      _positions[next[encodeCard(cards[i])]++] = i;
+   }
+
+   /**
+    * A code's triples change when it appears or disappears, or when it
+    * gains or loses the three copies it needs to form a set with itself.
+    */
+   std::array<bool, NUM_CARD_CODES> changed = {};
+   int numChanged = 0;
+   int numPresent = 0;
+   for (int code = 0; code < NUM_CARD_CODES; code++) {
+      changed[code] = (counts[code] > 0) != (_counts[code] > 0) ||
+         (counts[code] >= 3) != (_counts[code] >= 3);
+      numChanged += changed[code];
+      numPresent += counts[code] > 0;
+   }
+
+   if (numChanged > numPresent * MAX_INCREMENTAL_CHANGE_FRACTION) {
+      recomputeAll(counts);
+      _numFullUpdates++;
+   } else if (numChanged > 0) {
+      recomputeChanged(counts, changed);
+      _numIncrementalUpdates++;
+   } else {
+      _numIncrementalUpdates++;
+   }
+   _counts = counts;
+
+   // Expand each triple into a set for every combination of matching cards
+   sets.clear();
+   const int* positions = _positions.data();
+   for (const auto& setCodes : _setCodes) {
+      const int s0 = starts[setCodes[0]], e0 = starts[setCodes[0] + 1];
+      const int s1 = starts[setCodes[1]], e1 = starts[setCodes[1] + 1];
+      const int s2 = starts[setCodes[2]], e2 = starts[setCodes[2] + 1];
+      if (setCodes[0] == setCodes[2]) {
+         for (int i = s0; i < e0; i++) {
+            for (int j = i + 1; j < e0; j++) {
+               for (int k = j + 1; k < e0; k++) {
+                  sets.push_back(Set({ cards[positions[i]], cards[positions[j]], cards[positions[k]] }));
+               }
+            }
+         }
+         continue;
+      }
+
+      for (int i = s0; i < e0; i++) {
+         for (int j = s1; j < e1; j++) {
+            for (int k = s2; k < e2; k++) {
+               sets.push_back(Set({ cards[positions[i]], cards[positions[j]], cards[positions[k]] }));
+            }
+         }
+      }
+   }
+
+   sortSets(sets);
+}
+
+void
+IncrementalSetSolver::reset()
+{
+   _counts.fill(0);
+   _setCodes.clear();
+}
+
+void
+IncrementalSetSolver::recomputeAll(
+   const std::array<int, NUM_CARD_CODES>& counts)
+{
+   _setCodes.clear();
+   for (int c0 = 0; c0 < NUM_CARD_CODES; c0++) {
+      if (!present(counts, c0)) continue;
+
+      if (counts[c0] >= 3) _setCodes.push_back({ (CardCode)c0, (CardCode)c0, (CardCode)c0 });
+      for (int c1 = c0 + 1; c1 < NUM_CARD_CODES; c1++) {
+         if (!present(counts, c1)) continue;
+
+         const CardCode c2 = BatchSolver::thirdCard(c0, c1);
+         if (c2 > c1 && present(counts, c2)) {
+            _setCodes.push_back({ (CardCode)c0, (CardCode)c1, c2 });
+         }
+      }
+   }
+}
+
+void
+IncrementalSetSolver::recomputeChanged(
+   const std::array<int, NUM_CARD_CODES>& counts,
+   const std::array<bool, NUM_CARD_CODES>& changed)
+{
+   // Drop every triple that contains a changed code
+   _setCodes.erase(std::remove_if(_setCodes.begin(), _setCodes.end(),
+      [&](const SetCodes& setCodes) {
+         return changed[setCodes[0]] || changed[setCodes[1]] || changed[setCodes[2]];
+      }
+   ), _setCodes.end());
+
+   /**
+    * Find the triples containing a changed code that are sets now.  A
+    * triple can contain several changed codes, so it's only added when
+    * found from the smallest of them.
+    */
+   for (int c0 = 0; c0 < NUM_CARD_CODES; c0++) {
+      if (!changed[c0] || !present(counts, c0)) continue;
+
+      if (counts[c0] >= 3) _setCodes.push_back({ (CardCode)c0, (CardCode)c0, (CardCode)c0 });
+      for (int c1 = 0; c1 < NUM_CARD_CODES; c1++) {
+         if (c1 == c0 || !present(counts, c1) || (changed[c1] && c1 < c0)) continue;
+
+         const CardCode c2 = BatchSolver::thirdCard(c0, c1);
+         if (c2 < c1 || !present(counts, c2) || (changed[c2] && c2 < c0)) continue;
+
+         SetCodes setCodes = { (CardCode)c0, (CardCode)c1, c2 };
+         std::sort(setCodes.begin(), setCodes.end());
+         _setCodes.push_back(setCodes);
+      }
+   }
+}
+
+void
+IncrementalSetSolver::sortSets(
+   std::vector<Set>& sets)
+{
+   std::sort(sets.begin(), sets.end(),
+      [](const Set& s0, const Set& s1) {
+         if (s0 < s1) return true;
+         if (s1 < s0) return false;
+
+         for (int i = 0; i < 3; i++) {
+            if (s0.cards[i].contourIndex != s1.cards[i].contourIndex) {
+               return s0.cards[i].contourIndex < s1.cards[i].contourIndex;
+            }
+         }
+         return false;
+      }
+   );
+}
+
+} // namespace SetGame
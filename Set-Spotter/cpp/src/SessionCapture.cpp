@@ -0,0 +1,341 @@
+//
+//  SessionCapture.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#include "SessionCapture.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+const int RECORD_ALIGNMENT = 8;
+
+static uint64_t
+recordSize(
+   const FrameRecordHeader& header)
+{
+   uint64_t size = sizeof(FrameRecordHeader) + header.payloadSize +
+      header.numCards * sizeof(SetGame::CardCode) +
+      header.numSets * sizeof(RecordedSet);
+   return (size + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+}
+
+/**
+ * Size of the record at offset in the mapped file, or 0 if there isn't a
+ * complete record there.  Everything in the header comes from the file, so
+ * each part of the record is checked against what's left of the file
+ * before the parts are added up.
+ */
+static uint64_t
+recordSizeAt(
+   const uint8_t* data,
+   const uint64_t fileSize,
+   const uint64_t offset)
+{
+   if (offset % RECORD_ALIGNMENT != 0 || offset < sizeof(SessionFileHeader) || offset > fileSize ||
+       fileSize - offset < sizeof(FrameRecordHeader)) {
+      return 0;
+   }
+
+   const FrameRecordHeader* header = (const FrameRecordHeader*)(data + offset);
+   if (header->magic != FRAME_RECORD_MAGIC) return 0;
+
+   const uint64_t available = fileSize - offset - sizeof(FrameRecordHeader);
+   const uint64_t resultsSize = (uint64_t)header->numCards * sizeof(SetGame::CardCode) +
+      (uint64_t)header->numSets * sizeof(RecordedSet);
+   if (header->payloadSize > available || resultsSize > available - header->payloadSize) return 0;
+
+   const uint64_t size = recordSize(*header);
+   return size <= fileSize - offset ? size : 0;
+}
+
+SessionRecorder::SessionRecorder(
+   const std::string& path,
+   FrameEncoding encoding) :
+      _file(path, std::ios::binary | std::ios::trunc),
+      _encoding(encoding),
+      _start(std::chrono::steady_clock::now())
+{
+   if (!_file) {
+      throw std::runtime_error("Unable to create capture file " + path);
+   }
+
+   SessionFileHeader header {};
+   header.magic = SESSION_FILE_MAGIC;
+   header.version = SESSION_FILE_VERSION;
+   _file.write((const char*)&header, sizeof(header));
+}
+
+SessionRecorder::~SessionRecorder()
+{
+   close();
+}
+
+void
+SessionRecorder::append(
+   const cv::Mat& frame,
+   const FrameProcessor& frameProcessor)
+{
+   std::vector<uchar> encoded;
+   cv::Mat continuousFrame;
+   const uchar* payload;
+   uint64_t payloadSize;
+   if (_encoding == FrameEncoding::PNG) {
+      cv::imencode(".png", frame, encoded);
+      payload = encoded.data();
+      payloadSize = encoded.size();
+   } else {
+      continuousFrame = frame.isContinuous() ? frame : frame.clone();
+      payload = continuousFrame.data;
+      payloadSize = continuousFrame.total() * continuousFrame.elemSize();
+   }
+
+   std::vector<SetGame::CardCode> cards =
+      SessionReplay::encodeCards(frameProcessor.GetCardsInFrame());
+   std::vector<RecordedSet> sets =
+      SessionReplay::encodeSets(frameProcessor.GetSetsInFrame());
+
+   std::chrono::duration<double, std::milli> timestamp =
+      std::chrono::steady_clock::now() - _start;
+
+   FrameRecordHeader header {};
+   header.magic = FRAME_RECORD_MAGIC;
+   header.encoding = _encoding;
+   header.rows = frame.rows;
+   header.cols = frame.cols;
+   header.type = frame.type();
+   header.numCards = cards.size();
+   header.numSets = sets.size();
+   header.payloadSize = payloadSize;
+   header.timestampMillis = timestamp.count();
+   header.stageMillis = frameProcessor.GetStageMillis();
+
+   const uint64_t offset = _file.tellp();
+   const uint64_t unpaddedSize = sizeof(header) + payloadSize +
+      cards.size() * sizeof(SetGame::CardCode) + sets.size() * sizeof(RecordedSet);
+   const std::array<char, RECORD_ALIGNMENT> padding = {};
+
+   _file.write((const char*)&header, sizeof(header));
+   _file.write((const char*)payload, payloadSize);
+   _file.write((const char*)cards.data(), cards.size() * sizeof(SetGame::CardCode));
+   _file.write((const char*)sets.data(), sets.size() * sizeof(RecordedSet));
+   _file.write(padding.data(), recordSize(header) - unpaddedSize);
+   if (!_file) {
+      throw std::runtime_error("Failed to write frame to capture file");
+   }
+
+   _index.push_back(offset);
+}
+
+void
+SessionRecorder::close()
+{
+   if (!_file.is_open()) return;
+
+   SessionFileFooter footer {};
+   footer.indexOffset = _file.tellp();
+   footer.numFrames = _index.size();
+   footer.magic = SESSION_FOOTER_MAGIC;
+
+   _file.write((const char*)_index.data(), _index.size() * sizeof(uint64_t));
+   _file.write((const char*)&footer, sizeof(footer));
+   _file.close();
+}
+
+SessionReplay::SessionReplay(
+   const std::string& path)
+{
+   _fd = open(path.c_str(), O_RDONLY);
+   if (_fd < 0) {
+      throw std::runtime_error("Unable to open capture file " + path);
+   }
+
+   struct stat fileStat;
+   if (fstat(_fd, &fileStat) != 0 || fileStat.st_size < sizeof(SessionFileHeader)) {
+      ::close(_fd);
+      throw std::runtime_error("Capture file is too small " + path);
+   }
+   _size = fileStat.st_size;
+
+   void* mapped = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+   if (mapped == MAP_FAILED) {
+      ::close(_fd);
+      throw std::runtime_error("Unable to map capture file " + path);
+   }
+   _data = (const uint8_t*)mapped;
+
+   const SessionFileHeader* header = (const SessionFileHeader*)_data;
+   if (header->magic != SESSION_FILE_MAGIC || header->version != SESSION_FILE_VERSION) {
+      munmap((void*)_data, _size);
+      ::close(_fd);
+      throw std::runtime_error("Not a capture file " + path);
+   }
+
+   buildIndex();
+}
+
+SessionReplay::~SessionReplay()
+{
+   munmap((void*)_data, _size);
+   ::close(_fd);
+}
+
+void
+SessionReplay::buildIndex()
+{
+   // Use the index if the capture was closed cleanly and every entry in it is a whole record
+   if (_size >= sizeof(SessionFileHeader) + sizeof(SessionFileFooter)) {
+      SessionFileFooter footer;
+      std::memcpy(&footer, _data + _size - sizeof(SessionFileFooter), sizeof(footer));
+      const uint64_t indexSpace = _size - sizeof(SessionFileHeader) - sizeof(SessionFileFooter);
+      if (footer.magic == SESSION_FOOTER_MAGIC && footer.numFrames <= indexSpace / sizeof(uint64_t) &&
+          footer.indexOffset == _size - sizeof(SessionFileFooter) - footer.numFrames * sizeof(uint64_t) &&
+          footer.indexOffset % sizeof(uint64_t) == 0) {
+         const uint64_t* index = (const uint64_t*)(_data + footer.indexOffset);
+         _offsets.assign(index, index + footer.numFrames);
+         const bool valid = std::all_of(_offsets.begin(), _offsets.end(),
+            [&](const uint64_t offset) {
+               return recordSizeAt(_data, footer.indexOffset, offset) > 0;
+            }
+         );
+         if (valid) return;
+
+         _offsets.clear();
+      }
+   }
+
+   // Otherwise walk the records, stopping at the first incomplete one
+   uint64_t offset = sizeof(SessionFileHeader);
+   uint64_t size;
+   while ((size = recordSizeAt(_data, _size, offset)) > 0) {
+      _offsets.push_back(offset);
+      offset += size;
+   }
+}
+
+RecordedFrame
+SessionReplay::getFrame(
+   const int frameIndex) const
+{
+   // buildIndex only keeps offsets of records that lie wholly inside the mapping
+   const uint8_t* record = _data + _offsets.at(frameIndex);
+   const FrameRecordHeader* header = (const FrameRecordHeader*)record;
+   const uint8_t* payload = record + sizeof(FrameRecordHeader);
+   const uint8_t* cards = payload + header->payloadSize;
+   const RecordedSet* sets = (const RecordedSet*)(cards + header->numCards);
+
+   RecordedFrame recordedFrame;
+   recordedFrame.header = header;
+   if (header->encoding == FrameEncoding::PNG) {
+      cv::Mat encoded(1, header->payloadSize, CV_8U, (void*)payload);
+      recordedFrame.frame = cv::imdecode(encoded, cv::IMREAD_UNCHANGED);
+   } else {
+      // A raw frame is viewed in place, so its shape has to account for exactly the payload
+      if (header->rows <= 0 || header->cols <= 0 || (header->type & ~CV_MAT_TYPE_MASK) != 0) {
+         throw std::runtime_error("Corrupt frame record " + std::to_string(frameIndex));
+      }
+      const uint64_t rowBytes = (uint64_t)header->cols * CV_ELEM_SIZE(header->type);
+      if (header->payloadSize % rowBytes != 0 || header->payloadSize / rowBytes != (uint64_t)header->rows) {
+         throw std::runtime_error("Corrupt frame record " + std::to_string(frameIndex));
+      }
+      recordedFrame.frame = cv::Mat(header->rows, header->cols, header->type, (void*)payload);
+   }
+   recordedFrame.cards.assign(cards, cards + header->numCards);
+   recordedFrame.sets.assign(sets, sets + header->numSets);
+
+   return recordedFrame;
+}
+
+ReplayReport
+SessionReplay::run(
+   FrameProcessor& frameProcessor,
+   bool recordedRate) const
+{
+   ReplayReport report;
+   report.numFrames = GetNumFrames();
+   if (report.numFrames == 0) return report;
+
+   std::vector<double> latencies;
+   cv::Mat frame;
+   auto replayStart = std::chrono::steady_clock::now();
+   for (int i = 0; i < report.numFrames; i++) {
+      RecordedFrame recordedFrame = getFrame(i);
+      if (recordedRate) {
+         std::chrono::duration<double, std::milli> timestamp(recordedFrame.header->timestampMillis);
+         std::this_thread::sleep_until(replayStart +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(timestamp));
+      }
+
+      // The processor draws on the frame so it can't use the read-only mapping
+      recordedFrame.frame.copyTo(frame);
+
+      auto start = std::chrono::steady_clock::now();
+      frameProcessor.Process(frame);
+      std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - start;
+      latencies.push_back(latency.count());
+      if (frameProcessor.GetFrameIsPartial()) report.numPartialFrames++;
+      report.numApproximatedCards += frameProcessor.GetApproximatedCards().size();
+
+      if (encodeCards(frameProcessor.GetCardsInFrame()) != recordedFrame.cards ||
+          encodeSets(frameProcessor.GetSetsInFrame()) != recordedFrame.sets) {
+         report.numMismatchedFrames++;
+      }
+   }
+   std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - replayStart;
+   report.fps = report.numFrames / elapsed.count();
+
+   // Jitter is the mean difference in latency between consecutive frames
+   double jitterSum = 0;
+   for (int i = 1; i < latencies.size(); i++) {
+      jitterSum += std::abs(latencies[i] - latencies[i - 1]);
+   }
+   report.jitterMillis = latencies.size() > 1 ? jitterSum / (latencies.size() - 1) : 0;
+
+   std::sort(latencies.begin(), latencies.end());
+   report.p50Millis = latencies[latencies.size() / 2];
+   report.p99Millis = latencies[std::min<size_t>(latencies.size() - 1, latencies.size() * 99 / 100)];
+
+   return report;
+}
+
+/**
+ * Cards and sets are recorded in a canonical order (sorted by code) so a
+ * replay can be compared with the recording regardless of the order in
+ * which they were found.
+ */
+std::vector<SetGame::CardCode>
+SessionReplay::encodeCards(
+   const std::vector<SetGame::Card>& cards)
+{
+   std::vector<SetGame::CardCode> codes;
+   for (const auto& card : cards) {
+      codes.push_back(SetGame::encodeCard(card));
+   }
+   std::sort(codes.begin(), codes.end());
+
+   return codes;
+}
+
+std::vector<RecordedSet>
+SessionReplay::encodeSets(
+   const std::vector<SetGame::Set>& sets)
+{
+   std::vector<RecordedSet> recordedSets;
+   for (const auto& set : sets) {
+      RecordedSet recordedSet;
+      for (int i = 0; i < 3; i++) {
+         recordedSet[i] = SetGame::encodeCard(set.cards[i]);
+      }
+      std::sort(recordedSet.begin(), recordedSet.end());
+      recordedSets.push_back(recordedSet);
+   }
+   std::sort(recordedSets.begin(), recordedSets.end());
+
+   return recordedSets;
+}
@@ -49,10 +49,7 @@ bool
 Card::operator<(
    const Card& other) const
 {
-   if (count < other.count) return true;
-   if (other.count < count) return false;
-
-   return shape < other.shape;
+   return encodeCard(*this) < encodeCard(other);
 }
 
 std::string
@@ -61,73 +58,53 @@ Card::toString() const
    return std::to_string(count) + " " + shape.toString();
 }
 
+Set::Set(
+   const std::array<Card, 3>& cards) :
+      cards(cards)
+{
+   // Break ties between identical cards by contour index so the order doesn't depend on the caller's
+   auto ordered = [](const Card& c0, const Card& c1) {
+      const CardCode code0 = encodeCard(c0);
+      const CardCode code1 = encodeCard(c1);
+      return code0 < code1 || (code0 == code1 && c0.contourIndex < c1.contourIndex);
+   };
+   if (ordered(this->cards[1], this->cards[0])) std::swap(this->cards[0], this->cards[1]);
+   if (ordered(this->cards[2], this->cards[1])) std::swap(this->cards[1], this->cards[2]);
+   if (ordered(this->cards[1], this->cards[0])) std::swap(this->cards[0], this->cards[1]);
+}
+
+/**
+ * Cards with an unknown attribute or count can't be part of a set; the
+ * rest are checked with a single third-card lookup.
+ */
 bool
 Set::isSet(
    const Card& c0,
    const Card& c1,
    const Card& c2)
 {
-   auto allSame = [](int i0, int i1, int i2) {
-      return i0 == i1 && i1 == i2;
-   };
-   auto allDiff = [](int i0, int i1, int i2) {
-      return i0 != i1 && i1 != i2 && i0 != i2;
-   };
+   for (const Card* card : { &c0, &c1, &c2 }) {
+      if (card->count < 1 || card->count > 3 ||
+          card->shape.color == Color::UNKNOWN ||
+          card->shape.symbol == Symbol::UNKNOWN ||
+          card->shape.shading == Shading::UNKNOWN) return false;
+   }
 
-   // Check counts
-   if (!allSame(c0.count, c1.count, c2.count) &&
-       !allDiff(c0.count, c1.count, c2.count)) return false;
-
-   // Check colors
-   if (!allSame(
-         static_cast<int>(c0.shape.color),
-         static_cast<int>(c1.shape.color),
-         static_cast<int>(c2.shape.color)) &&
-      !allDiff(
-         static_cast<int>(c0.shape.color),
-         static_cast<int>(c1.shape.color),
-         static_cast<int>(c2.shape.color))) return false;
-
-   // Check symbols
-   if (!allSame(
-         static_cast<int>(c0.shape.symbol),
-         static_cast<int>(c1.shape.symbol),
-         static_cast<int>(c2.shape.symbol)) &&
-      !allDiff(
-         static_cast<int>(c0.shape.symbol),
-         static_cast<int>(c1.shape.symbol),
-         static_cast<int>(c2.shape.symbol))) return false;
-
-   // Check shadings
-   if (!allSame(
-         static_cast<int>(c0.shape.shading),
-         static_cast<int>(c1.shape.shading),
-         static_cast<int>(c2.shape.shading)) &&
-      !allDiff(
-         static_cast<int>(c0.shape.shading),
-         static_cast<int>(c1.shape.shading),
-         static_cast<int>(c2.shape.shading))) return false;
-
-   // It's a set
-   return true;
+   return StandardSetEngine::isSet({ encodeCard(c0), encodeCard(c1), encodeCard(c2) });
 }
 
 bool
 Set::operator<(
    const Set& other) const
 {
-   /**
-    * We only need to consider the first card in each set object's
-    * "cards" vector for the following two reasons:
-    *
-    *   1. There are no duplicate cards in Set
-    *   2. Each set object's "cards" vector is already sorted
-    *
-    * Because of this, we can be assured that the first card in each
-    * set object's "cards" vector is different, AND it represents the
-    * "smallest" card in that set object's vector.
-    */
-   return cards[0] < other.cards[0];
+   // Each set's cards are already sorted so compare them in order
+   for (int i = 0; i < 3; i++) {
+      const CardCode code = encodeCard(cards[i]);
+      const CardCode otherCode = encodeCard(other.cards[i]);
+      if (code != otherCode) return code < otherCode;
+   }
+
+   return false;
 }
 
 std::string
@@ -141,4 +118,17 @@ Set::toString() const
    return output;
 }
 
+Card
+decodeCard(
+   const CardCode code,
+   const int contourIndex)
+{
+   Shape shape(
+      static_cast<Color>((code / 3) % 3),
+      static_cast<Symbol>((code / 9) % 3),
+      static_cast<Shading>((code / 27) % 3));
+
+   return Card(shape, code % 3 + 1, contourIndex);
+}
+
 } // namespace SetGame
@@ -0,0 +1,170 @@
+//
+//  ShmRing.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#include "ShmRing.h"
+
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t
+alignUp(
+   const uint64_t size)
+{
+   return (size + SHM_RING_ALIGNMENT - 1) / SHM_RING_ALIGNMENT * SHM_RING_ALIGNMENT;
+}
+
+ShmRing::ShmRing(
+   const std::string& name,
+   const uint32_t numSlots,
+   const uint64_t slotSize) :
+      _name(name),
+      _owner(true)
+{
+   if (numSlots == 0) {
+      throw std::runtime_error("Ring needs at least one slot");
+   }
+
+   shm_unlink(name.c_str());
+   _fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+   if (_fd < 0) {
+      throw std::runtime_error("Unable to create shared memory " + name);
+   }
+
+   const uint64_t slotStride = alignUp(sizeof(ShmSlotHeader)) + alignUp(slotSize);
+   const size_t size = alignUp(sizeof(ShmRingHeader)) + numSlots * slotStride;
+   if (ftruncate(_fd, size) != 0) {
+      ::close(_fd);
+      shm_unlink(name.c_str());
+      throw std::runtime_error("Unable to size shared memory " + name);
+   }
+   map(size, PROT_READ | PROT_WRITE);
+
+   _header = new (_data) ShmRingHeader;
+   _header->version = SHM_RING_VERSION;
+   _header->numSlots = numSlots;
+   _header->slotSize = slotSize;
+   _header->slotStride = slotStride;
+   _header->writePosition.store(0, std::memory_order_relaxed);
+   _header->readPosition.store(0, std::memory_order_relaxed);
+   for (uint32_t i = 0; i < numSlots; i++) {
+      ShmSlotHeader* slotHeader = new (slot(i)) ShmSlotHeader;
+      slotHeader->size = 0;
+      slotHeader->sequence.store(i, std::memory_order_relaxed);
+   }
+
+   // Publish the magic last so openers never see a half-initialized ring
+   std::atomic_thread_fence(std::memory_order_release);
+   _header->magic = SHM_RING_MAGIC;
+}
+
+ShmRing::ShmRing(
+   const std::string& name) :
+      _name(name)
+{
+   _fd = shm_open(name.c_str(), O_RDWR, 0600);
+   if (_fd < 0) {
+      throw std::runtime_error("Unable to open shared memory " + name);
+   }
+
+   struct stat fileStat;
+   if (fstat(_fd, &fileStat) != 0 || fileStat.st_size < sizeof(ShmRingHeader)) {
+      ::close(_fd);
+      throw std::runtime_error("Shared memory is too small " + name);
+   }
+   map(fileStat.st_size, PROT_READ | PROT_WRITE);
+
+   _header = (ShmRingHeader*)_data;
+   std::atomic_thread_fence(std::memory_order_acquire);
+   if (_header->magic != SHM_RING_MAGIC || _header->version != SHM_RING_VERSION ||
+       alignUp(sizeof(ShmRingHeader)) + _header->numSlots * _header->slotStride > _size) {
+      munmap(_data, _size);
+      ::close(_fd);
+      throw std::runtime_error("Not a ring " + name);
+   }
+}
+
+ShmRing::~ShmRing()
+{
+   munmap(_data, _size);
+   ::close(_fd);
+   if (_owner) shm_unlink(_name.c_str());
+}
+
+void
+ShmRing::map(
+   const size_t size,
+   const int flags)
+{
+   void* mapped = mmap(NULL, size, flags, MAP_SHARED, _fd, 0);
+   if (mapped == MAP_FAILED) {
+      ::close(_fd);
+      if (_owner) shm_unlink(_name.c_str());
+      throw std::runtime_error("Unable to map shared memory " + _name);
+   }
+   _data = (uint8_t*)mapped;
+   _size = size;
+}
+
+ShmSlotHeader*
+ShmRing::slot(
+   const uint64_t position) const
+{
+   const uint64_t index = position % _header->numSlots;
+   return (ShmSlotHeader*)(_data + alignUp(sizeof(ShmRingHeader)) + index * _header->slotStride);
+}
+
+uint64_t
+ShmRing::GetNumQueued() const
+{
+   return _header->writePosition.load(std::memory_order_relaxed) -
+      _header->readPosition.load(std::memory_order_relaxed);
+}
+
+uint8_t*
+ShmRing::tryAcquireWrite()
+{
+   const uint64_t position = _header->writePosition.load(std::memory_order_relaxed);
+   ShmSlotHeader* slotHeader = slot(position);
+   if (slotHeader->sequence.load(std::memory_order_acquire) != position) return nullptr;
+
+   return (uint8_t*)slotHeader + alignUp(sizeof(ShmSlotHeader));
+}
+
+void
+ShmRing::commitWrite(
+   const uint64_t size)
+{
+   const uint64_t position = _header->writePosition.load(std::memory_order_relaxed);
+   ShmSlotHeader* slotHeader = slot(position);
+   slotHeader->size = size;
+   slotHeader->sequence.store(position + 1, std::memory_order_release);
+   _header->writePosition.store(position + 1, std::memory_order_relaxed);
+}
+
+uint8_t*
+ShmRing::tryAcquireRead(
+   uint64_t& size)
+{
+   const uint64_t position = _header->readPosition.load(std::memory_order_relaxed);
+   ShmSlotHeader* slotHeader = slot(position);
+   if (slotHeader->sequence.load(std::memory_order_acquire) != position + 1) return nullptr;
+
+   size = slotHeader->size;
+   return (uint8_t*)slotHeader + alignUp(sizeof(ShmSlotHeader));
+}
+
+void
+ShmRing::releaseRead()
+{
+   const uint64_t position = _header->readPosition.load(std::memory_order_relaxed);
+   slot(position)->sequence.store(position + _header->numSlots, std::memory_order_release);
+   _header->readPosition.store(position + 1, std::memory_order_relaxed);
+}
@@ -0,0 +1,50 @@
+//
+//  SymbolClassifier.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#include "SymbolClassifier.h"
+
+// Rule-based classification, tuned on real cards
+const float RULES_APPROX_ACCURACY = 0.08;
+const float SHAPE_MATCH_DIAMOND_THRESHOLD = 0.065;
+const float SOLIDITY_SQUIGGLE_PILL_THRESHOLD = 0.9;
+
+/**
+ * Detect contour's symbol by comparing the approximate, 4-sided contour to the actual contour.
+ * If it's within a certain similarity then it's a diamond because diamonds are the shape that can most
+ * accurately be approximated with only 4 sides.  If it's not a diamond then use the convex hull to distinguish
+ * between squiggles and ovals.
+ */
+SetGame::Symbol
+SymbolClassifier::classifyByRules(
+   const std::vector<cv::Point>& contour)
+{
+   const double peri = cv::arcLength(contour, true) * RULES_APPROX_ACCURACY;
+   std::vector<cv::Point> approx;
+   cv::approxPolyDP(contour, approx, peri, true);
+   double shapeMatchRatio = cv::matchShapes(contour, approx, cv::CONTOURS_MATCH_I1, 0);
+   if (shapeMatchRatio < SHAPE_MATCH_DIAMOND_THRESHOLD) {
+      return SetGame::Symbol::DIAMOND;
+   }
+
+   std::vector<cv::Point> hull;
+   cv::convexHull(contour, hull);
+   double solidityRatio = cv::contourArea(contour) / cv::contourArea(hull);
+   return (solidityRatio < SOLIDITY_SQUIGGLE_PILL_THRESHOLD) ?
+      SetGame::Symbol::SQUIGGLE :
+      SetGame::Symbol::OVAL;
+}
+
+void
+SymbolClassifier::classifyContours(
+   const std::vector<const std::vector<cv::Point>*>& contours,
+   std::vector<SetGame::Symbol>& symbols)
+{
+   symbols.clear();
+   for (const std::vector<cv::Point>* contour : contours) {
+      symbols.push_back(classifyByRules(*contour));
+   }
+}
@@ -6,9 +6,57 @@
 //
 
 #include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __APPLE__
+#include <sys/qos.h>
+#include <sys/sysctl.h>
+#endif
 
 namespace ThreadPool {
 
+// Weight given to the newest sample in the parallelize cost estimates
+const double COST_ESTIMATE_SMOOTHING = 0.2;
+
+// Starting estimate for handing a partition to a worker (enqueue, wake, wait)
+const double INITIAL_DISPATCH_NANOS = 20000;
+
+/**
+ * A handoff sample is capped at this, so a worker that was descheduled
+ * for one run can't make the pool look too expensive to use again.
+ */
+const double MAX_DISPATCH_NANOS = 1000000;
+
+/**
+ * The handoff estimate only learns from pooled runs, so after this many
+ * runs in a row go inline the next one goes to the pool anyway.
+ */
+const int DISPATCH_PROBE_INTERVAL = 64;
+
+/**
+ * Max frequencies vary a little between cores of one type (boost bins,
+ * binning), so when they're all the detectCores has, cores only count as
+ * different types if the slowest is below this fraction of the fastest.
+ * Performance cores are then the ones at or above it.
+ */
+const double HETEROGENEOUS_FREQUENCY_RATIO = 0.8;
+
 PoolTask::PoolTask()
 {
    status = PoolTaskStatus::NOT_STARTED;
@@ -25,42 +73,63 @@ PoolTask::~PoolTask()
 void* startThread(void* arg)
 {
    ThreadPool* instance = (ThreadPool*)arg;
+
+#ifdef __linux__
+   // Niceness is per thread on Linux, so it has to be set from the worker itself
+   if (instance->_options.niceness &&
+       setpriority(PRIO_PROCESS, syscall(SYS_gettid), *instance->_options.niceness) != 0) {
+      // Raising priority (a negative niceness) needs CAP_SYS_NICE
+      std::cout << "Unable to set worker niceness to " << *instance->_options.niceness << ": " <<
+         std::strerror(errno) << std::endl;
+   }
+#endif
+
    while (true) {
       // Get task if there is one
       PoolTask* task;
       pthread_mutex_lock(&instance->_queueMutex);
       while (instance->_queue.empty()) {
+         TRACE_SPAN("ThreadPool::wait");
          pthread_cond_wait(&instance->_queueCond, &instance->_queueMutex);
       }
 
-      task = instance->_queue.front();
+      task = instance->_queue.top();
       instance->_queue.pop();
       pthread_mutex_unlock(&instance->_queueMutex);
+      TRACE_INSTANT("ThreadPool::dequeue");
 
       if (task->threadCancelled) break;
 
+      // The group may have been cancelled after the task was queued
+      if (task->group && task->group->isCancelled()) {
+         pthread_mutex_lock(&task->statusMutex);
+         task->status = PoolTaskStatus::CANCELLED;
+         pthread_cond_signal(&task->statusCond);
+         pthread_mutex_unlock(&task->statusMutex);
+         continue;
+      }
+
       bool taskFailed = false;
       try {
+         TRACE_SPAN("ThreadPool::run");
          pthread_mutex_lock(&task->statusMutex);
          task->status = PoolTaskStatus::RUNNING;
          pthread_mutex_unlock(&task->statusMutex);
+         auto runStart = std::chrono::steady_clock::now();
          task->func(task->arg);
+         std::chrono::nanoseconds runTime = std::chrono::steady_clock::now() - runStart;
+         task->runNanos = runTime.count();
       } catch (...) {
          // TODO: enhance this
          std::cout << "Error during task execution, failing task" << std::endl;
-         pthread_mutex_lock(&task->statusMutex);
-         task->status = PoolTaskStatus::FAILED;
-         pthread_mutex_unlock(&task->statusMutex);
          taskFailed = true;
       }
 
-      if (!taskFailed) {
-         pthread_mutex_lock(&task->statusMutex);
-         task->status = PoolTaskStatus::SUCCEEDED;
-         pthread_mutex_unlock(&task->statusMutex);
-      }
-
+      // Signal while holding the lock, the waiter may destroy the task as soon as it sees the status
+      pthread_mutex_lock(&task->statusMutex);
+      task->status = taskFailed ? PoolTaskStatus::FAILED : PoolTaskStatus::SUCCEEDED;
       pthread_cond_signal(&task->statusCond);
+      pthread_mutex_unlock(&task->statusMutex);
    }
 
    // Do any clean up required before thread exits
@@ -68,21 +137,54 @@ void* startThread(void* arg)
 }
 
 ThreadPool::ThreadPool(
-   int numThreads)
+   int numThreads) :
+      ThreadPool(ThreadPoolOptions { .numThreads = numThreads })
+{
+}
+
+ThreadPool::ThreadPool(
+   const ThreadPoolOptions& options) :
+      _options(options)
 {
-   _numThreads = numThreads;
+   _numThreads = _options.numThreads == AUTO_NUM_THREADS ?
+      numPerformanceCores() :
+      _options.numThreads;
+
+   if (_options.performanceCoresOnly && _options.cpuSet.empty()) {
+      for (const CoreInfo& core : detectCores()) {
+         if (core.performance) _options.cpuSet.push_back(core.cpu);
+      }
+   }
+
+   _activeThreads = _numThreads;
+   _stats.partitionCounts.resize(_numThreads + 1);
+   _stats.dispatchNanos = INITIAL_DISPATCH_NANOS;
 
    pthread_mutex_init(&_queueMutex, NULL);
    pthread_cond_init(&_queueCond, NULL);
+   pthread_mutex_init(&_statsMutex, NULL);
+
+   pthread_attr_t attr;
+   pthread_attr_init(&attr);
+#ifdef __APPLE__
+   if (_options.niceness) {
+      qos_class_t qosClass = *_options.niceness < 0 ? QOS_CLASS_USER_INTERACTIVE :
+         *_options.niceness == 0 ? QOS_CLASS_USER_INITIATED :
+         QOS_CLASS_UTILITY;
+      pthread_attr_set_qos_class_np(&attr, qosClass, 0);
+   }
+#endif
 
    for (int i = 0; i < _numThreads; i++) {
       pthread_t thread;
-      int ret = pthread_create(&thread, NULL, &startThread, this);
+      int ret = pthread_create(&thread, &attr, &startThread, this);
       if (ret != 0) {
          exit(EXIT_FAILURE);
       }
+      placeWorker(thread, i);
       _threads.push_back(thread);
    }
+   pthread_attr_destroy(&attr);
 }
 
 ThreadPool::~ThreadPool()
@@ -92,7 +194,7 @@ ThreadPool::~ThreadPool()
     * for every thread in the threadpool.
     */
    std::vector<PoolTask> tasks(_numThreads);
-   std::queue<PoolTask* const> newQueue;
+   PoolTaskQueue newQueue;
    for (int i = 0; i < _numThreads; i++) {
       PoolTask task;
       task.threadCancelled = true;
@@ -114,13 +216,41 @@ ThreadPool::~ThreadPool()
 
    pthread_mutex_destroy(&_queueMutex);
    pthread_cond_destroy(&_queueCond);
+   pthread_mutex_destroy(&_statsMutex);
+}
+
+void
+ThreadPool::placeWorker(
+   pthread_t thread,
+   const int workerIndex) const
+{
+   if (_options.cpuSet.empty()) return;
+
+#ifdef __linux__
+   cpu_set_t cpuSet;
+   CPU_ZERO(&cpuSet);
+   if (_options.pinEachWorker) {
+      CPU_SET(_options.cpuSet[workerIndex % _options.cpuSet.size()], &cpuSet);
+   } else {
+      for (int cpu : _options.cpuSet) {
+         CPU_SET(cpu, &cpuSet);
+      }
+   }
+
+   int ret = pthread_setaffinity_np(thread, sizeof(cpuSet), &cpuSet);
+   if (ret != 0) {
+      std::cout << "Unable to set affinity for worker " << workerIndex << std::endl;
+   }
+#endif
 }
 
 void
 ThreadPool::enqueue(
    PoolTask* const task)
 {
+   TRACE_INSTANT("ThreadPool::enqueue");
    pthread_mutex_lock(&_queueMutex);
+   task->sequence = _nextSequence++;
    _queue.push(task);
    pthread_mutex_unlock(&_queueMutex);
    pthread_cond_broadcast(&_queueCond);
@@ -130,10 +260,12 @@ PoolTaskStatus
 ThreadPool::waitForTask(
    PoolTask* const task) const
 {
+   TRACE_SPAN("ThreadPool::waitForTask");
    PoolTaskStatus status;
    pthread_mutex_lock(&task->statusMutex);
    while (task->status != PoolTaskStatus::FAILED &&
-            task->status != PoolTaskStatus::SUCCEEDED) {
+            task->status != PoolTaskStatus::SUCCEEDED &&
+            task->status != PoolTaskStatus::CANCELLED) {
       pthread_cond_wait(&task->statusCond, &task->statusMutex);
    }
    status = task->status;
@@ -142,6 +274,38 @@ ThreadPool::waitForTask(
    return status;
 }
 
+void
+ThreadPool::cancelGroup(
+   const std::shared_ptr<TaskGroup>& group)
+{
+   TRACE_INSTANT("ThreadPool::cancelGroup");
+   group->cancel();
+
+   // Pull the group's tasks out of the queue so nobody waits for a worker to skip them
+   std::vector<PoolTask*> cancelledTasks;
+   pthread_mutex_lock(&_queueMutex);
+   PoolTaskQueue remaining;
+   while (!_queue.empty()) {
+      PoolTask* task = _queue.top();
+      _queue.pop();
+      if (task->group == group) {
+         cancelledTasks.push_back(task);
+      } else {
+         remaining.push(task);
+      }
+   }
+   _queue.swap(remaining);
+   pthread_mutex_unlock(&_queueMutex);
+
+   // Signal under the lock, the waiter frees the task as soon as it sees the status
+   for (PoolTask* task : cancelledTasks) {
+      pthread_mutex_lock(&task->statusMutex);
+      task->status = PoolTaskStatus::CANCELLED;
+      pthread_cond_signal(&task->statusCond);
+      pthread_mutex_unlock(&task->statusMutex);
+   }
+}
+
 /**
  * In order to maximize efficiency the elements in the container should
  * be split as evenly as possible between the threads.  To put the goal
@@ -178,4 +342,204 @@ ThreadPool::partition(
    return n % x;
 }
 
+/**
+ * Predicted latency for running work W (W = total cost * ns per cost unit)
+ * is W when it's run inline on the calling thread and
+ *
+ *    W / p + p * D
+ *
+ * when it's split into p partitions on the pool, where D is the cost of
+ * handing a partition to a worker and waiting for it.  Return the p with
+ * the lowest predicted latency, or 0 if running inline is best.  Until
+ * there's an estimate for the cost of the work use every thread.  Every
+ * DISPATCH_PROBE_INTERVAL inline runs, the best pooled partitioning is
+ * used instead so the handoff estimate stays current.
+ *
+ * @param [in] totalCost : Sum of the cost function over the container
+ * @param [in] numElements : # of elements in the container
+ *
+ * @return # of partitions to use, 0 to run on the calling thread
+ */
+int
+ThreadPool::choosePartitions(
+   const double totalCost,
+   const int numElements)
+{
+   const int maxPartitions = std::min(numElements, _activeThreads);
+   pthread_mutex_lock(&_statsMutex);
+   if (_stats.nanosPerCostUnit == 0) {
+      pthread_mutex_unlock(&_statsMutex);
+      return maxPartitions;
+   }
+
+   const double workNanos = totalCost * _stats.nanosPerCostUnit;
+   int bestPartitions = 1;
+   double bestLatency = std::numeric_limits<double>::max();
+   for (int p = 1; p <= maxPartitions; p++) {
+      const double latency = workNanos / p + p * _stats.dispatchNanos;
+      if (latency < bestLatency) {
+         bestLatency = latency;
+         bestPartitions = p;
+      }
+   }
+
+   if (bestLatency >= workNanos) {
+      if (++_inlineRunsSinceProbe < DISPATCH_PROBE_INTERVAL) {
+         bestPartitions = 0;
+      } else {
+         _stats.probeRuns++;
+      }
+   }
+   if (bestPartitions > 0) _inlineRunsSinceProbe = 0;
+   pthread_mutex_unlock(&_statsMutex);
+
+   return bestPartitions;
+}
+
+/**
+ * Update the cost model and counters after a run.  runNanos is the time
+ * spent in targetFn summed over all partitions, wallNanos is how long the
+ * caller of parallelize waited.
+ */
+void
+ThreadPool::recordRun(
+   const int numPartitions,
+   const double totalCost,
+   const int64_t runNanos,
+   const int64_t wallNanos)
+{
+   auto smooth = [](double estimate, double sample) {
+      return estimate == 0 ? sample :
+         estimate + COST_ESTIMATE_SMOOTHING * (sample - estimate);
+   };
+
+   pthread_mutex_lock(&_statsMutex);
+   if (numPartitions == 0) {
+      _stats.inlineRuns++;
+   } else {
+      _stats.pooledRuns++;
+   }
+   _stats.partitionCounts[numPartitions]++;
+
+   if (totalCost > 0) {
+      _stats.nanosPerCostUnit = smooth(_stats.nanosPerCostUnit, runNanos / totalCost);
+      if (numPartitions > 0) {
+         // Whatever the caller waited beyond the average partition is handoff overhead
+         const double overheadNanos = wallNanos - (double)runNanos / numPartitions;
+         _stats.dispatchNanos = smooth(_stats.dispatchNanos,
+            std::clamp(overheadNanos / numPartitions, 0.0, MAX_DISPATCH_NANOS));
+      }
+   }
+   pthread_mutex_unlock(&_statsMutex);
+}
+
+ParallelizeStats
+ThreadPool::GetParallelizeStats() const
+{
+   pthread_mutex_lock(&_statsMutex);
+   ParallelizeStats stats = _stats;
+   pthread_mutex_unlock(&_statsMutex);
+
+   return stats;
+}
+
+#ifdef __linux__
+/**
+ * The CPUs that are online, from a list of ranges like "0-3,6".  Offline
+ * CPUs still count towards _SC_NPROCESSORS_CONF but can't run workers.
+ */
+static std::vector<int>
+onlineCpus()
+{
+   std::vector<int> cpus;
+   std::ifstream onlineFile("/sys/devices/system/cpu/online");
+   std::string range;
+   while (std::getline(onlineFile, range, ',')) {
+      int first = 0;
+      int last = 0;
+      const int numParsed = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+      if (numParsed < 1) continue;
+      if (numParsed == 1) last = first;
+      for (int cpu = first; cpu <= last; cpu++) {
+         cpus.push_back(cpu);
+      }
+   }
+
+   if (cpus.empty()) {
+      const long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+      for (int cpu = 0; cpu < numCpus; cpu++) {
+         cpus.push_back(cpu);
+      }
+   }
+
+   return cpus;
+}
+#endif
+
+/**
+ * On Linux, heterogeneous (big.LITTLE) systems expose each CPU's relative
+ * capacity in sysfs.  When that's missing fall back to each CPU's max
+ * frequency, which only splits the cores into types when the gap is large
+ * (HETEROGENEOUS_FREQUENCY_RATIO).  If neither is available treat every
+ * CPU as a performance core.
+ */
+std::vector<CoreInfo>
+ThreadPool::detectCores()
+{
+   std::vector<CoreInfo> cores;
+   bool fromFrequency = false;
+#ifdef __linux__
+   for (const int cpu : onlineCpus()) {
+      const std::string cpuDir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+      long capacity = 0;
+      std::ifstream capacityFile(cpuDir + "/cpu_capacity");
+      if (!(capacityFile >> capacity)) {
+         std::ifstream freqFile(cpuDir + "/cpufreq/cpuinfo_max_freq");
+         if (freqFile >> capacity) {
+            fromFrequency = true;
+         } else {
+            capacity = 1;
+         }
+      }
+      cores.push_back({ cpu, capacity, false });
+   }
+#else
+   const int numCpus = std::thread::hardware_concurrency();
+   for (int cpu = 0; cpu < numCpus; cpu++) {
+      cores.push_back({ cpu, 1, false });
+   }
+#endif
+
+   long maxCapacity = 0;
+   for (const CoreInfo& core : cores) {
+      maxCapacity = std::max(maxCapacity, core.capacity);
+   }
+   const long performanceCapacity = fromFrequency ?
+      (long)(maxCapacity * HETEROGENEOUS_FREQUENCY_RATIO) : maxCapacity;
+   for (CoreInfo& core : cores) {
+      core.performance = core.capacity >= performanceCapacity;
+   }
+
+   return cores;
+}
+
+int
+ThreadPool::numPerformanceCores()
+{
+   int count = 0;
+#ifdef __APPLE__
+   // CPU ids aren't exposed on Apple platforms but the performance core count is
+   size_t size = sizeof(count);
+   if (sysctlbyname("hw.perflevel0.logicalcpu", &count, &size, NULL, 0) != 0) {
+      count = 0;
+   }
+#else
+   for (const CoreInfo& core : detectCores()) {
+      count += core.performance;
+   }
+#endif
+
+   return count > 0 ? count : DEFAULT_NUM_THREADS;
+}
+
 } // namespace ThreadPool
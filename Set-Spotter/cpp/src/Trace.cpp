@@ -0,0 +1,131 @@
+//
+//  Trace.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+
+#include "Trace.h"
+
+#include <array>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Trace {
+
+std::atomic<bool> enabled(false);
+
+namespace {
+
+struct Event {
+   const char* name;
+   int64_t startMicros;
+   int64_t durationMicros; // -1 for instant events
+};
+
+/**
+ * Single-producer ring buffer.  Only the owning thread writes events; the
+ * head is published with release ordering so dump sees complete events.
+ */
+struct ThreadBuffer {
+   int threadId;
+   std::atomic<uint64_t> head { 0 };
+   std::array<Event, THREAD_BUFFER_CAPACITY> events;
+};
+
+const TimePoint epoch = std::chrono::steady_clock::now();
+
+// Buffers outlive their threads so spans from exited threads can still be dumped
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+ThreadBuffer*
+getThreadBuffer()
+{
+   thread_local ThreadBuffer* buffer = nullptr;
+   if (buffer == nullptr) {
+      std::lock_guard<std::mutex> lock(registryMutex);
+      registry.push_back(std::make_unique<ThreadBuffer>());
+      buffer = registry.back().get();
+      buffer->threadId = registry.size();
+   }
+
+   return buffer;
+}
+
+int64_t
+toMicros(
+   const TimePoint& timePoint)
+{
+   return std::chrono::duration_cast<std::chrono::microseconds>(timePoint - epoch).count();
+}
+
+void
+record(
+   const Event& event)
+{
+   ThreadBuffer* buffer = getThreadBuffer();
+   const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+   buffer->events[head % THREAD_BUFFER_CAPACITY] = event;
+   buffer->head.store(head + 1, std::memory_order_release);
+}
+
+} // namespace
+
+void
+setEnabled(
+   bool enable)
+{
+   enabled.store(enable, std::memory_order_relaxed);
+}
+
+void
+recordSpan(
+   const char* name,
+   const TimePoint& start,
+   const TimePoint& end)
+{
+   const int64_t startMicros = toMicros(start);
+   record({ name, startMicros, toMicros(end) - startMicros });
+}
+
+void
+recordInstant(
+   const char* name)
+{
+   record({ name, toMicros(std::chrono::steady_clock::now()), -1 });
+}
+
+bool
+dump(
+   const std::string& path)
+{
+   std::ofstream file(path);
+   if (!file) return false;
+
+   file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+   bool first = true;
+   std::lock_guard<std::mutex> lock(registryMutex);
+   for (const auto& buffer : registry) {
+      const uint64_t head = buffer->head.load(std::memory_order_acquire);
+      const uint64_t count = std::min<uint64_t>(head, THREAD_BUFFER_CAPACITY);
+      for (uint64_t i = head - count; i < head; i++) {
+         const Event& event = buffer->events[i % THREAD_BUFFER_CAPACITY];
+         file << (first ? "" : ",") << "\n{\"name\":\"" << event.name <<
+            "\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << event.startMicros;
+         if (event.durationMicros < 0) {
+            file << ",\"ph\":\"i\",\"s\":\"t\"}";
+         } else {
+            file << ",\"ph\":\"X\",\"dur\":" << event.durationMicros << "}";
+         }
+         first = false;
+      }
+   }
+   file << "\n]}\n";
+
+   return file.good();
+}
+
+} // namespace Trace
@@ -0,0 +1,91 @@
+//
+//  IngestDaemon.cpp
+//  Set-Spotter
+//
+//  Created by JD del Alamo on 10/18/26.
+//
+//  Standalone shared-memory ingest daemon, not part of the app target.  From cpp/:
+//
+//    c++ -std=c++20 -O2 -Iinclude tools/IngestDaemon.cpp src/*.cpp $(pkg-config --cflags --libs opencv4) -lpthread -lrt
+//
+//  Usage: a.out [--frames NAME] [--results NAME] [--slots N] [--max-frame-bytes N]
+//               [--profile FAST|BALANCED|ACCURATE] [--sampling MASKED|SPARSE] [--threads N]
+//               [--cancel-stale]
+//
+//  Creates the frame and result rings, processes frames until interrupted
+//  and prints a summary on exit.  Feed it with bench/IngestBenchmark.cpp.
+//
+
+#include "FrameIngest.h"
+
+#include <csignal>
+#include <cstring>
+#include <iostream>
+
+static std::atomic<bool> stopRequested(false);
+
+static void
+requestStop(int)
+{
+   stopRequested.store(true);
+}
+
+int
+main(int argc, char** argv)
+{
+   std::string frameRingName = "/set-spotter-frames";
+   std::string resultRingName = "/set-spotter-results";
+   uint32_t numSlots = DEFAULT_INGEST_SLOTS;
+   uint64_t maxFrameBytes = DEFAULT_MAX_FRAME_BYTES;
+   ProcessingProfile profile = ProcessingProfile::ACCURATE;
+   ShapeSamplingMode samplingMode = ShapeSamplingMode::MASKED;
+   int numThreads = tp::DEFAULT_NUM_THREADS;
+   bool cancelStaleFrames = false;
+   for (int i = 1; i < argc; i++) {
+      if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+         frameRingName = argv[++i];
+      } else if (std::strcmp(argv[i], "--results") == 0 && i + 1 < argc) {
+         resultRingName = argv[++i];
+      } else if (std::strcmp(argv[i], "--slots") == 0 && i + 1 < argc) {
+         numSlots = std::atoi(argv[++i]);
+      } else if (std::strcmp(argv[i], "--max-frame-bytes") == 0 && i + 1 < argc) {
+         maxFrameBytes = std::atoll(argv[++i]);
+      } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+         const std::string name = argv[++i];
+         for (int p = 0; p < PROCESSING_PROFILE_TO_STRING.size(); p++) {
+            if (PROCESSING_PROFILE_TO_STRING[p] == name) profile = static_cast<ProcessingProfile>(p);
+         }
+      } else if (std::strcmp(argv[i], "--sampling") == 0 && i + 1 < argc) {
+         const std::string name = argv[++i];
+         for (int m = 0; m < SHAPE_SAMPLING_MODE_TO_STRING.size(); m++) {
+            if (SHAPE_SAMPLING_MODE_TO_STRING[m] == name) samplingMode = static_cast<ShapeSamplingMode>(m);
+         }
+      } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+         numThreads = std::atoi(argv[++i]);
+      } else if (std::strcmp(argv[i], "--cancel-stale") == 0) {
+         cancelStaleFrames = true;
+      } else {
+         std::cout << "unknown argument " << argv[i] << std::endl;
+         return EXIT_FAILURE;
+      }
+   }
+
+   FrameProcessor frameProcessor(numThreads, false);
+   frameProcessor.SetProfile(profile);
+   frameProcessor.SetShapeSamplingMode(samplingMode);
+   FrameIngestDaemon daemon(frameProcessor, frameRingName, resultRingName, numSlots, maxFrameBytes);
+   daemon.SetCancelStaleFrames(cancelStaleFrames);
+
+   std::signal(SIGINT, requestStop);
+   std::signal(SIGTERM, requestStop);
+   std::cout << "Ingesting from " << frameRingName << ", publishing to " << resultRingName << std::endl;
+   daemon.run(stopRequested);
+
+   const IngestStats& stats = daemon.GetStats();
+   std::cout << "frames: " << stats.numFrames << ", invalid: " << stats.numInvalidFrames <<
+      ", cancelled: " << stats.numCancelledFrames << ", skipped: " << stats.numSkippedFrames <<
+      ", dropped results: " << stats.numDroppedResults << ", mean process (ms): " <<
+      (stats.numFrames > 0 ? stats.processMillis / stats.numFrames : 0) << std::endl;
+
+   return EXIT_SUCCESS;
+}